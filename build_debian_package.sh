@@ -62,6 +62,99 @@ if [ "$MODULE" = "libagl-zlib-dev" ]; then
 	LONG_DESCRIPTION="Libagl zlib wrapper delelopement files"
 fi
 
+if [ "$MODULE" = "libagl-lz4" ]; then
+	cmake .
+	make agl_lz4
+
+	mkdir -p $TEMPDIR/data/usr/lib/
+	cp src/Lz4/libagl_lz4.so $TEMPDIR/data/usr/lib/
+
+	NAME="libagl-lz4"
+	MAINTAINER_NAME="Henrik Heino"
+	MAINTAINER_EMAIL="henrik.heino@gmail.com"
+	SECTION="libs"
+	DEPS="liblz4-1"
+	SHORT_DESCRIPTION="Libagl LZ4 wrapper"
+	LONG_DESCRIPTION="Libagl LZ4 wrapper"
+fi
+
+if [ "$MODULE" = "libagl-lz4-dev" ]; then
+	mkdir -p $TEMPDIR/data/usr/include/libagl/
+	cp -r include/Lz4 $TEMPDIR/data/usr/include/libagl/
+
+	NAME="libagl-lz4-dev"
+	MAINTAINER_NAME="Henrik Heino"
+	MAINTAINER_EMAIL="henrik.heino@gmail.com"
+	SECTION="libdevel"
+	PC_FILE="agl-lz4"
+	LIBS="-lagl_lz4 -llz4"
+	DEPS="liblz4-dev, libagl-dev, libagl-lz4"
+	SHORT_DESCRIPTION="Libagl LZ4 wrapper developement files"
+	LONG_DESCRIPTION="Libagl LZ4 wrapper delelopement files"
+fi
+
+if [ "$MODULE" = "libagl-zstd" ]; then
+	cmake .
+	make agl_zstd
+
+	mkdir -p $TEMPDIR/data/usr/lib/
+	cp src/Zstd/libagl_zstd.so $TEMPDIR/data/usr/lib/
+
+	NAME="libagl-zstd"
+	MAINTAINER_NAME="Henrik Heino"
+	MAINTAINER_EMAIL="henrik.heino@gmail.com"
+	SECTION="libs"
+	DEPS="libzstd1"
+	SHORT_DESCRIPTION="Libagl Zstandard wrapper"
+	LONG_DESCRIPTION="Libagl Zstandard wrapper"
+fi
+
+if [ "$MODULE" = "libagl-zstd-dev" ]; then
+	mkdir -p $TEMPDIR/data/usr/include/libagl/
+	cp -r include/Zstd $TEMPDIR/data/usr/include/libagl/
+
+	NAME="libagl-zstd-dev"
+	MAINTAINER_NAME="Henrik Heino"
+	MAINTAINER_EMAIL="henrik.heino@gmail.com"
+	SECTION="libdevel"
+	PC_FILE="agl-zstd"
+	LIBS="-lagl_zstd -lzstd"
+	DEPS="libzstd-dev, libagl-dev, libagl-zstd"
+	SHORT_DESCRIPTION="Libagl Zstandard wrapper developement files"
+	LONG_DESCRIPTION="Libagl Zstandard wrapper delelopement files"
+fi
+
+if [ "$MODULE" = "libagl-checksum" ]; then
+	cmake .
+	make agl_checksum
+
+	mkdir -p $TEMPDIR/data/usr/lib/
+	cp src/Checksum/libagl_checksum.so $TEMPDIR/data/usr/lib/
+
+	NAME="libagl-checksum"
+	MAINTAINER_NAME="Henrik Heino"
+	MAINTAINER_EMAIL="henrik.heino@gmail.com"
+	SECTION="libs"
+	DEPS=""
+	SHORT_DESCRIPTION="Libagl checksums"
+	LONG_DESCRIPTION="Libagl checksums"
+fi
+
+if [ "$MODULE" = "libagl-checksum-dev" ]; then
+	mkdir -p $TEMPDIR/data/usr/include/libagl/
+	cp -r include/Checksum $TEMPDIR/data/usr/include/libagl/
+
+	NAME="libagl-checksum-dev"
+	MAINTAINER_NAME="Henrik Heino"
+	MAINTAINER_EMAIL="henrik.heino@gmail.com"
+	SECTION="libdevel"
+	PC_FILE="agl-checksum"
+	LIBS="-lagl_checksum"
+	DEPS="libagl-dev, libagl-checksum"
+	SHORT_DESCRIPTION="Libagl checksums developement files"
+	LONG_DESCRIPTION="Libagl checksums delelopement files"
+fi
+
 # Ensure proper module was selected
 if [ -z "$NAME" ]; then
 	echo "Invalid module!"
@@ -0,0 +1,366 @@
+#ifndef AGL_ASYNCSTREAM_HPP
+#define AGL_ASYNCSTREAM_HPP
+
+#include "SpscRbuf.hpp"
+#include "Stream.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <stdint.h>
+
+namespace Agl
+{
+
+// Runs a Stream on a dedicated worker thread. Pushing only queues the data,
+// and the worker thread does the actual processing. Processed data can be
+// read without blocking, or waited for. Exceptions of the worker thread are
+// thrown from the pushing, reading and waiting functions.
+//
+// Data is passed to and from the worker through lock-free ring buffers,
+// so one thread must do all the pushing, and one thread all the reading.
+// These can be the same thread.
+class AsyncStream
+{
+
+public:
+
+	static size_t const DEFAULT_CAPACITY = 1024 * 1024;
+
+	// "stream" is not owned, and it must not be used directly while
+	// AsyncStream exists. At most "input_capacity" bytes of pushed data
+	// wait for the worker thread, and at most "output_capacity" bytes of
+	// processed data wait for reading. When input is full, pushing waits
+	// until there is room, and when output is full, worker waits. So if
+	// pushing and reading are done in the same thread, output must fit.
+	inline AsyncStream(Stream& stream, size_t input_capacity = DEFAULT_CAPACITY, size_t output_capacity = DEFAULT_CAPACITY);
+	// Stops worker thread. Data that is not processed yet, is dropped.
+	inline ~AsyncStream();
+
+	inline void push(const Bytes& bytes);
+	inline void push(const std::string& str);
+	inline void push(const char* bytes, uint64_t size);
+
+	// Informs stream, that all data is got. No more data will be pushed.
+	inline void setEndOfData();
+
+	// Functions to read data that has been processed so far. These never block.
+	inline Bytes readBytes(size_t limit = 0);
+	inline std::string readString(size_t limit = 0);
+	inline size_t readInto(uint8_t* result, size_t capacity);
+
+	// Waits until there is processed data available, or until
+	// everything has been processed. Returns amount of available data.
+	inline size_t waitForOutput();
+	// Waits until everything that has been pushed is processed. If output
+	// does not fit, it must be read meanwhile, or this waits forever.
+	inline void wait();
+	// Returns true, when end of data has been processed and read
+	inline bool finished() const;
+
+	// Sets function that is called from worker thread every time after
+	// new processed data is available, and when processing ends.
+	inline void setCallback(std::function< void () > const& callback);
+
+	// Limits processed data that waits for reading. When there is "high"
+	// bytes or more, worker thread pauses until reading has drained it
+	// to "low" bytes. Zero "high" means that only output capacity limits
+	// it, which is the default. Otherwise "low" must be smaller than "high".
+	inline void setOutputLimits(size_t high, size_t low);
+
+private:
+
+	static size_t const MOVE_CHUNK_SIZE = 64 * 1024;
+
+	// Settings that worker thread uses
+	struct Settings
+	{
+		std::function< void () > callback;
+		size_t output_high;
+		size_t output_low;
+	};
+
+	Stream& stream;
+
+	SpscRbuf< uint8_t > input;
+	SpscRbuf< uint8_t > output;
+
+	// Written only by pushing thread
+	std::atomic< bool > input_closed;
+	std::atomic< uint64_t > pushed;
+
+	// Bytes of input that worker has processed completely
+	std::atomic< uint64_t > processed;
+	std::atomic< bool > ended;
+	std::atomic< bool > stopping;
+	// Error is set only once, before "failed"
+	std::exception_ptr error;
+	std::atomic< bool > failed;
+
+	// Protects settings, and lets callers wait for worker. Worker takes it
+	// only when settings have changed, or when somebody is waiting.
+	mutable std::mutex mutex;
+	std::condition_variable progress_cond;
+	std::atomic< unsigned > waiters;
+	std::atomic< bool > settings_changed;
+	Settings settings;
+
+	std::thread worker;
+
+	AsyncStream(AsyncStream const&);
+	AsyncStream& operator=(AsyncStream const&);
+
+	inline void run();
+
+	// Moves all output of stream to the output buffer. Returns
+	// false, if worker should stop. Runs in worker thread.
+	inline bool moveOutput(Bytes& chunk, Settings& current);
+
+	// Copies changed settings for worker thread
+	inline void updateSettings(Settings& current);
+
+	// Wakes up callers of wait(), if there are any
+	inline void notifyProgress();
+
+	inline void throwWorkerError() const;
+
+};
+
+inline AsyncStream::AsyncStream(Stream& stream, size_t input_capacity, size_t output_capacity) :
+	stream(stream),
+	input(input_capacity, true),
+	output(output_capacity, true),
+	input_closed(false),
+	pushed(0),
+	processed(0),
+	ended(false),
+	stopping(false),
+	failed(false),
+	waiters(0),
+	settings_changed(false),
+	worker()
+{
+	settings.output_high = 0;
+	settings.output_low = 0;
+	worker = std::thread(&AsyncStream::run, this);
+}
+
+inline AsyncStream::~AsyncStream()
+{
+	stopping = true;
+	input.close();
+	output.close();
+	worker.join();
+}
+
+inline void AsyncStream::push(const Bytes& bytes)
+{
+	push((const char*)bytes.data(), bytes.size());
+}
+
+inline void AsyncStream::push(const std::string& str)
+{
+	push(str.c_str(), str.size());
+}
+
+inline void AsyncStream::push(const char* bytes, uint64_t size)
+{
+	throwWorkerError();
+	if (input_closed) throw Stream::StreamInputClosed();
+	// Worker closes input, if it fails
+	if (!input.insertAll((uint8_t const*)bytes, (uint8_t const*)bytes + size)) {
+		throwWorkerError();
+		throw Stream::StreamInputClosed();
+	}
+	pushed += size;
+}
+
+inline void AsyncStream::setEndOfData()
+{
+	if (input_closed) throw Stream::StreamInputClosed();
+	input_closed = true;
+	input.close();
+}
+
+inline Bytes AsyncStream::readBytes(size_t limit)
+{
+	throwWorkerError();
+
+	size_t amount_to_copy = output.size();
+	if (limit > 0 && limit < amount_to_copy) amount_to_copy = limit;
+
+	Bytes result(amount_to_copy, 0);
+	output.read(result.data(), amount_to_copy);
+	return result;
+}
+
+inline std::string AsyncStream::readString(size_t limit)
+{
+	throwWorkerError();
+
+	size_t amount_to_copy = output.size();
+	if (limit > 0 && limit < amount_to_copy) amount_to_copy = limit;
+
+	std::string result(amount_to_copy, ' ');
+	output.read((uint8_t*)&result[0], amount_to_copy);
+	return result;
+}
+
+inline size_t AsyncStream::readInto(uint8_t* result, size_t capacity)
+{
+	throwWorkerError();
+	return output.read(result, capacity);
+}
+
+inline size_t AsyncStream::waitForOutput()
+{
+	size_t available = output.waitForItems();
+	throwWorkerError();
+	return available;
+}
+
+inline void AsyncStream::wait()
+{
+	std::unique_lock< std::mutex > lock(mutex);
+	++ waiters;
+	// Pairs with the fence in notifyProgress()
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	while ((processed < pushed || input_closed) && !ended) {
+		progress_cond.wait(lock);
+	}
+	-- waiters;
+	throwWorkerError();
+}
+
+inline bool AsyncStream::finished() const
+{
+	return ended && output.empty();
+}
+
+inline void AsyncStream::setCallback(std::function< void () > const& callback)
+{
+	std::lock_guard< std::mutex > lock(mutex);
+	settings.callback = callback;
+	settings_changed = true;
+}
+
+inline void AsyncStream::setOutputLimits(size_t high, size_t low)
+{
+	if (high > 0 && low >= high) throw std::runtime_error("Low limit of output must be smaller than high limit!");
+	std::lock_guard< std::mutex > lock(mutex);
+	settings.output_high = high;
+	settings.output_low = low;
+	settings_changed = true;
+}
+
+inline void AsyncStream::run()
+{
+	Bytes input_chunk(MOVE_CHUNK_SIZE);
+	Bytes output_chunk(MOVE_CHUNK_SIZE);
+	Settings current;
+	current.output_high = 0;
+	current.output_low = 0;
+
+	try {
+		while (true) {
+			// Returns zero only after end of data
+			size_t amount = input.readWait(input_chunk.data(), input_chunk.size());
+			if (stopping) {
+				return;
+			}
+			updateSettings(current);
+
+			if (amount > 0) {
+				stream.push((char const*)input_chunk.data(), amount);
+			} else {
+				stream.setEndOfData();
+			}
+			if (!moveOutput(output_chunk, current)) {
+				return;
+			}
+			if (amount == 0) {
+				break;
+			}
+			processed += amount;
+			notifyProgress();
+		}
+	}
+	catch (...) {
+		error = std::current_exception();
+		failed = true;
+		// Stops pushing thread, if it waits for room
+		input.close();
+	}
+
+	ended = true;
+	output.close();
+	notifyProgress();
+	if (current.callback) {
+		current.callback();
+	}
+}
+
+inline bool AsyncStream::moveOutput(Bytes& chunk, Settings& current)
+{
+	// Reading may resume paused processing of
+	// stream, so continue until nothing is left.
+	while (stream.outputSize() > 0) {
+		size_t room = chunk.size();
+		if (current.output_high > 0) {
+			// Only reading thread makes output smaller
+			if (output.size() >= current.output_high && !output.waitForSize(current.output_low)) {
+				return false;
+			}
+			size_t ready = output.size();
+			if (ready < current.output_high && current.output_high - ready < room) {
+				room = current.output_high - ready;
+			}
+		}
+
+		size_t amount = stream.readInto(chunk.data(), room);
+		if (!output.insertAll(chunk.data(), chunk.data() + amount)) {
+			return false;
+		}
+
+		if (current.callback) {
+			current.callback();
+		}
+		updateSettings(current);
+	}
+	return true;
+}
+
+inline void AsyncStream::updateSettings(Settings& current)
+{
+	if (!settings_changed) {
+		return;
+	}
+	std::lock_guard< std::mutex > lock(mutex);
+	current = settings;
+	settings_changed = false;
+}
+
+inline void AsyncStream::notifyProgress()
+{
+	// Either this sees the waiter, or wait() sees the progress
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (waiters > 0) {
+		std::lock_guard< std::mutex > lock(mutex);
+		progress_cond.notify_all();
+	}
+}
+
+inline void AsyncStream::throwWorkerError() const
+{
+	if (failed) {
+		std::rethrow_exception(error);
+	}
+}
+
+}
+
+#endif
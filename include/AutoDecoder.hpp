@@ -0,0 +1,188 @@
+#ifndef AGL_AUTODECODER_HPP
+#define AGL_AUTODECODER_HPP
+
+#include "Stream.hpp"
+
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <stdint.h>
+
+namespace Agl
+{
+
+// Decompresses data of any codec that has a decoder set. Codec is
+// detected from the magic numbers in the beginning of the data, so
+// senders can pick codecs freely. Decoders are kept over reset(),
+// and reused when the same codec comes again.
+class AutoDecoder : public Stream
+{
+
+public:
+
+	enum Codec {
+		UNKNOWN,
+		ZLIB,
+		GZIP,
+		LZ4,
+		ZSTD,
+		CODEC_COUNT
+	};
+
+	// Returns a decoder created with new
+	typedef std::function< Stream* () > Factory;
+
+	inline AutoDecoder();
+
+	// Sets function that creates decoder for codec
+	inline void setDecoder(Codec codec, Factory const& factory);
+
+	// Returns codec of current data, or UNKNOWN, if not detected yet
+	inline Codec codec() const;
+
+	// Detects codec from the beginning of data. Four bytes are enough.
+	static inline Codec detect(uint8_t const* data, size_t size);
+
+private:
+
+	static size_t const HEADER_SIZE = 4;
+	static size_t const MOVE_CHUNK_SIZE = 64 * 1024;
+
+	Factory factories[CODEC_COUNT];
+	std::unique_ptr< Stream > decoders[CODEC_COUNT];
+
+	Codec current;
+	Bytes header;
+	bool decoder_closed;
+
+	virtual void newDataAvailable(uint64_t amount, bool end_of_data);
+	virtual void resetRequested();
+	virtual void flushRequested();
+
+	inline Stream& decoder();
+
+	// Moves output of decoder to own output, until it gets full
+	inline void moveOutput();
+
+};
+
+inline AutoDecoder::AutoDecoder() :
+	current(UNKNOWN),
+	decoder_closed(false)
+{
+}
+
+inline void AutoDecoder::setDecoder(Codec codec, Factory const& factory)
+{
+	factories[codec] = factory;
+	decoders[codec].reset();
+}
+
+inline AutoDecoder::Codec AutoDecoder::codec() const
+{
+	return current;
+}
+
+inline AutoDecoder::Codec AutoDecoder::detect(uint8_t const* data, size_t size)
+{
+	if (size >= 4 && data[0] == 0x28 && data[1] == 0xb5 && data[2] == 0x2f && data[3] == 0xfd) {
+		return ZSTD;
+	}
+	if (size >= 4 && data[0] == 0x04 && data[1] == 0x22 && data[2] == 0x4d && data[3] == 0x18) {
+		return LZ4;
+	}
+	if (size >= 2 && data[0] == 0x1f && data[1] == 0x8b) {
+		return GZIP;
+	}
+	// Zlib header is deflate method and a check value
+	if (size >= 2 && (data[0] & 0x0f) == 8 && ((data[0] << 8) | data[1]) % 31 == 0) {
+		return ZLIB;
+	}
+	return UNKNOWN;
+}
+
+inline void AutoDecoder::newDataAvailable(uint64_t amount, bool end_of_data)
+{
+	(void)amount;
+
+	if (current == UNKNOWN) {
+		readInputData(header, HEADER_SIZE - header.size());
+		if (header.size() < HEADER_SIZE && !end_of_data) {
+			return;
+		}
+		if (header.empty()) {
+			throw std::runtime_error("Unexpected end of compressed data!");
+		}
+		Codec codec = detect(header.data(), header.size());
+		if (codec == UNKNOWN) {
+			throw std::runtime_error("Unknown compression format!");
+		}
+		if (!factories[codec]) {
+			throw std::runtime_error("No decoder for compression format!");
+		}
+		if (!decoders[codec]) {
+			decoders[codec].reset(factories[codec]());
+		}
+		current = codec;
+		decoder().push(header);
+		header.clear();
+	}
+
+	// Output that did not fit earlier goes first
+	moveOutput();
+
+	// Pass input to decoder in pieces, so
+	// that its output does not grow too much.
+	uint8_t const* input_begin;
+	size_t input_size;
+	while (!outputFull() && (input_size = viewInputData(input_begin)) > 0) {
+		if (input_size > MOVE_CHUNK_SIZE) {
+			input_size = MOVE_CHUNK_SIZE;
+		}
+		decoder().push((char const*)input_begin, input_size);
+		consumeInputData(input_size);
+		moveOutput();
+	}
+
+	if (end_of_data && inputDataSize() == 0 && !decoder_closed) {
+		decoder_closed = true;
+		decoder().setEndOfData();
+		moveOutput();
+	}
+}
+
+inline void AutoDecoder::resetRequested()
+{
+	if (current != UNKNOWN) {
+		decoder().reset();
+	}
+	current = UNKNOWN;
+	header.clear();
+	decoder_closed = false;
+}
+
+inline void AutoDecoder::flushRequested()
+{
+	if (current != UNKNOWN) {
+		decoder().flush();
+		moveOutput();
+	}
+}
+
+inline Stream& AutoDecoder::decoder()
+{
+	return *decoders[current];
+}
+
+inline void AutoDecoder::moveOutput()
+{
+	while (!outputFull() && decoder().outputSize() > 0) {
+		uint8_t* output_begin;
+		size_t output_size = reserveOutputData(output_begin, MOVE_CHUNK_SIZE);
+		commitOutputData(decoder().readInto(output_begin, output_size));
+	}
+}
+
+}
+
+#endif
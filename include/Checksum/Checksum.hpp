@@ -0,0 +1,32 @@
+#ifndef AGL_CHECKSUM_CHECKSUM_HPP
+#define AGL_CHECKSUM_CHECKSUM_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace Agl
+{
+
+namespace Checksum
+{
+
+// Checksums are computed with SIMD instructions, if the processor has
+// them. To continue a checksum over more data, give the previous result
+// as the last argument. Results are the same as those of zlib, and
+// CRC-32C is the one used by iSCSI, ext4 and others.
+
+uint32_t crc32(uint8_t const* data, size_t size, uint32_t crc = 0);
+uint32_t crc32c(uint8_t const* data, size_t size, uint32_t crc = 0);
+uint32_t adler32(uint8_t const* data, size_t size, uint32_t adler = 1);
+
+// Combine checksums of two consecutive pieces of data, that are computed
+// separately, for example in parallel. "size2" is size of second piece.
+uint32_t crc32Combine(uint32_t crc1, uint32_t crc2, uint64_t size2);
+uint32_t crc32cCombine(uint32_t crc1, uint32_t crc2, uint64_t size2);
+uint32_t adler32Combine(uint32_t adler1, uint32_t adler2, uint64_t size2);
+
+}
+
+}
+
+#endif
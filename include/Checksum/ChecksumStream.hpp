@@ -0,0 +1,50 @@
+#ifndef AGL_CHECKSUM_CHECKSUMSTREAM_HPP
+#define AGL_CHECKSUM_CHECKSUMSTREAM_HPP
+
+#include "../Stream.hpp"
+
+namespace Agl
+{
+
+namespace Checksum
+{
+
+// Passes data through unchanged, and computes its checksum on the way.
+// Data is checksummed right before it is copied, while it is still in
+// cache, so as a stage of a Pipeline this costs much less than a
+// separate pass over the data.
+class ChecksumStream : public Stream
+{
+
+public:
+
+	enum Type {
+		CRC32,
+		CRC32C,
+		ADLER32
+	};
+
+	ChecksumStream(Type type = CRC32);
+
+	// Returns checksum and size of data that has passed through
+	uint32_t value() const;
+	uint64_t size() const;
+
+private:
+
+	Type type;
+	uint32_t checksum;
+	uint64_t total_size;
+
+	virtual void newDataAvailable(uint64_t amount, bool end_of_data);
+	virtual void resetRequested();
+
+	uint32_t initialValue() const;
+
+};
+
+}
+
+}
+
+#endif
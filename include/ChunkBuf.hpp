@@ -0,0 +1,318 @@
+#ifndef AGL_CHUNKBUF_HPP
+#define AGL_CHUNKBUF_HPP
+
+#include "Bytes.hpp"
+
+#include <deque>
+#include <memory>
+#include <utility>
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+
+namespace Agl
+{
+
+// Byte buffer made of a chain of reference counted blocks. Growing never
+// moves existing data. Big buffers can be handed over without copying, and
+// data can be sliced to another ChunkBuf so that both share the blocks.
+class ChunkBuf
+{
+
+public:
+
+	// Contiguous area of bytes inside the buffer
+	struct Region
+	{
+		uint8_t* begin;
+		size_t size;
+	};
+
+	inline ChunkBuf(size_t block_size = 16 * 1024);
+
+	inline void clear();
+	inline bool empty() const;
+	inline size_t size() const;
+	// Returns amount of memory held by blocks, including shared ones
+	inline size_t capacity() const;
+	inline size_t blockSize() const;
+	inline size_t blockCount() const;
+	// Returns how many blocks have been allocated since creation
+	inline size_t allocations() const;
+
+	// Copies bytes to the end of buffer
+	inline void insert(uint8_t const* begin, uint8_t const* end);
+	// Takes ownership of "bytes" without copying them
+	inline void append(Bytes&& bytes);
+	// Appends all data of another buffer by sharing its blocks
+	inline void append(ChunkBuf const& chunkbuf);
+
+	inline void read(uint8_t* result, size_t amount);
+	// Moves "amount" bytes from the start of this buffer to the
+	// end of "result". Blocks are shared instead of copying data.
+	inline void slice(ChunkBuf& result, size_t amount);
+
+	// Gets readable bytes as contiguous regions, in reading order. Writes
+	// at most "max_regions" regions and returns the amount that was
+	// written. Regions stay valid until the buffer is modified.
+	inline size_t readableRegions(Region* regions, size_t max_regions) const;
+	// Marks "amount" bytes from the start of readable regions as read.
+	inline void consume(size_t amount);
+
+	// Ensures there is contiguous free space for at least
+	// "min_amount" more bytes at the end, and gets all of it.
+	inline Region writableRegion(size_t min_amount = 1);
+	// Marks "amount" bytes from the start of writable region as written.
+	inline void commit(size_t amount);
+
+private:
+
+	struct Block
+	{
+		// Keeps the memory alive. Shared between ChunkBufs.
+		std::shared_ptr< uint8_t > owner;
+		size_t capacity;
+		// Range of bytes that belong to this buffer
+		size_t begin;
+		size_t end;
+	};
+	typedef std::deque< Block > Blocks;
+
+	Blocks blocks;
+	size_t items;
+	size_t block_size;
+	size_t allocation_count;
+	// Block that has been read empty, kept for reuse
+	std::shared_ptr< uint8_t > spare;
+
+	// Returns true if more data can be written to the end of the block
+	inline bool writable(Block const& block) const;
+	inline void newBlock(size_t min_capacity);
+	inline void releaseBlock(Block& block);
+
+};
+
+inline ChunkBuf::ChunkBuf(size_t block_size) :
+	items(0),
+	block_size(block_size),
+	allocation_count(0)
+{
+	if (block_size == 0) {
+		throw std::runtime_error("Block size must be positive!");
+	}
+}
+
+inline void ChunkBuf::clear()
+{
+	blocks.clear();
+	spare.reset();
+	items = 0;
+}
+
+inline bool ChunkBuf::empty() const
+{
+	return items == 0;
+}
+
+inline size_t ChunkBuf::size() const
+{
+	return items;
+}
+
+inline size_t ChunkBuf::capacity() const
+{
+	size_t result = spare ? block_size : 0;
+	for (Blocks::const_iterator it = blocks.begin(); it != blocks.end(); ++ it) {
+		result += it->capacity;
+	}
+	return result;
+}
+
+inline size_t ChunkBuf::blockSize() const
+{
+	return block_size;
+}
+
+inline size_t ChunkBuf::blockCount() const
+{
+	return blocks.size();
+}
+
+inline size_t ChunkBuf::allocations() const
+{
+	return allocation_count;
+}
+
+inline void ChunkBuf::insert(uint8_t const* begin, uint8_t const* end)
+{
+	while (begin < end) {
+		Region region = writableRegion(1);
+		size_t amount = end - begin;
+		if (amount > region.size) amount = region.size;
+		memcpy(region.begin, begin, amount);
+		commit(amount);
+		begin += amount;
+	}
+}
+
+inline void ChunkBuf::append(Bytes&& bytes)
+{
+	if (bytes.empty()) {
+		return;
+	}
+	// Vector is moved, so its data stays where it is
+	std::shared_ptr< Bytes > holder(new Bytes(std::move(bytes)));
+	Block block;
+	block.owner = std::shared_ptr< uint8_t >(holder, holder->data());
+	block.capacity = holder->size();
+	block.begin = 0;
+	block.end = holder->size();
+	blocks.push_back(block);
+	items += block.end;
+}
+
+inline void ChunkBuf::append(ChunkBuf const& chunkbuf)
+{
+	if (&chunkbuf == this) {
+		throw std::runtime_error("Unable to append ChunkBuf to itself!");
+	}
+	for (Blocks::const_iterator it = chunkbuf.blocks.begin(); it != chunkbuf.blocks.end(); ++ it) {
+		if (it->end > it->begin) {
+			blocks.push_back(*it);
+			items += it->end - it->begin;
+		}
+	}
+}
+
+inline void ChunkBuf::read(uint8_t* result, size_t amount)
+{
+	if (amount > items) {
+		throw std::runtime_error("Trying to read too much!");
+	}
+	while (amount > 0) {
+		Block& block = blocks.front();
+		size_t block_amount = block.end - block.begin;
+		if (block_amount > amount) block_amount = amount;
+		memcpy(result, block.owner.get() + block.begin, block_amount);
+		result += block_amount;
+		amount -= block_amount;
+		consume(block_amount);
+	}
+}
+
+inline void ChunkBuf::slice(ChunkBuf& result, size_t amount)
+{
+	if (&result == this) {
+		throw std::runtime_error("Unable to slice ChunkBuf to itself!");
+	}
+	if (amount > items) {
+		throw std::runtime_error("Trying to slice too much!");
+	}
+	while (amount > 0) {
+		Block block = blocks.front();
+		size_t block_amount = block.end - block.begin;
+		if (block_amount > amount) {
+			block_amount = amount;
+			block.end = block.begin + amount;
+		}
+		result.blocks.push_back(block);
+		result.items += block_amount;
+		amount -= block_amount;
+		consume(block_amount);
+	}
+}
+
+inline size_t ChunkBuf::readableRegions(Region* regions, size_t max_regions) const
+{
+	size_t count = 0;
+	for (Blocks::const_iterator it = blocks.begin(); it != blocks.end() && count < max_regions; ++ it) {
+		if (it->end > it->begin) {
+			regions[count].begin = it->owner.get() + it->begin;
+			regions[count].size = it->end - it->begin;
+			++ count;
+		}
+	}
+	return count;
+}
+
+inline void ChunkBuf::consume(size_t amount)
+{
+	if (amount > items) {
+		throw std::runtime_error("Trying to consume too much!");
+	}
+	items -= amount;
+	while (!blocks.empty()) {
+		Block& block = blocks.front();
+		size_t block_amount = block.end - block.begin;
+		if (block_amount > amount) {
+			block.begin += amount;
+			return;
+		}
+		amount -= block_amount;
+		// Keep the last block, if more data can still be written to it
+		if (blocks.size() == 1 && writable(block)) {
+			block.begin = 0;
+			block.end = 0;
+			return;
+		}
+		releaseBlock(block);
+		blocks.pop_front();
+	}
+}
+
+inline ChunkBuf::Region ChunkBuf::writableRegion(size_t min_amount)
+{
+	if (blocks.empty() || !writable(blocks.back()) || blocks.back().capacity - blocks.back().end < min_amount) {
+		newBlock(min_amount);
+	}
+	Block& block = blocks.back();
+	Region region;
+	region.begin = block.owner.get() + block.end;
+	region.size = block.capacity - block.end;
+	return region;
+}
+
+inline void ChunkBuf::commit(size_t amount)
+{
+	if (amount == 0) return;
+	if (blocks.empty() || !writable(blocks.back()) || blocks.back().capacity - blocks.back().end < amount) {
+		throw std::runtime_error("Trying to commit too much!");
+	}
+	blocks.back().end += amount;
+	items += amount;
+}
+
+inline bool ChunkBuf::writable(Block const& block) const
+{
+	// Shared blocks are never written, because other
+	// buffers might use the bytes after this range.
+	return block.end < block.capacity && block.owner.use_count() == 1;
+}
+
+inline void ChunkBuf::newBlock(size_t min_capacity)
+{
+	Block block;
+	if (min_capacity <= block_size && spare) {
+		block.owner.swap(spare);
+		block.capacity = block_size;
+	} else {
+		block.capacity = min_capacity > block_size ? min_capacity : block_size;
+		block.owner = std::shared_ptr< uint8_t >(new uint8_t[block.capacity], std::default_delete< uint8_t[] >());
+		++ allocation_count;
+	}
+	block.begin = 0;
+	block.end = 0;
+	blocks.push_back(block);
+}
+
+inline void ChunkBuf::releaseBlock(Block& block)
+{
+	// Keep one unshared block of standard size for reuse
+	if (!spare && block.capacity == block_size && block.owner.use_count() == 1) {
+		spare.swap(block.owner);
+	}
+}
+
+}
+
+#endif
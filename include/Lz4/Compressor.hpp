@@ -0,0 +1,55 @@
+#ifndef AGL_LZ4_COMPRESSOR_HPP
+#define AGL_LZ4_COMPRESSOR_HPP
+
+#include "../Stream.hpp"
+
+namespace Agl
+{
+
+namespace Lz4
+{
+
+// Compresses to LZ4 frame format, that the lz4 tool can also read.
+// Much faster than deflate, but does not compress as well.
+class Compressor : public Stream
+{
+
+public:
+
+	enum Level {
+		FAST,
+		DEFAULT_COMPRESSION,
+		BEST
+	};
+
+	Compressor(Level level = DEFAULT_COMPRESSION);
+	virtual ~Compressor();
+
+private:
+
+	void* cctx;
+	void* prefs;
+
+	bool frame_started;
+	bool frame_ended;
+	bool pending_flush;
+
+	// Used when output buffer has no contiguous room for the worst case
+	Bytes scratch;
+
+	virtual void newDataAvailable(uint64_t amount, bool end_of_data);
+	virtual void resetRequested();
+	virtual void flushRequested();
+
+	// Runs LZ4 function that needs room for "max_size" bytes of output,
+	// and writes its result to output buffer.
+	template< typename Function >
+	void writeOutput(size_t max_size, Function function);
+
+};
+
+}
+
+}
+
+#endif
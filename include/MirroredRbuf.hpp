@@ -0,0 +1,377 @@
+#ifndef AGL_MIRROREDRBUF_HPP
+#define AGL_MIRROREDRBUF_HPP
+
+#include <cstring>
+#include <cstdlib>
+#include <stdexcept>
+#include <new>
+#include <type_traits>
+#include <stdint.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+// Memory files need glibc 2.27 or newer
+#ifdef MFD_CLOEXEC
+#define AGL_MIRRORED_RBUF_SUPPORTED
+#endif
+#endif
+
+namespace Agl
+{
+
+// Ring buffer, where the same memory pages are mapped twice, back to
+// back. Because of this, readable items and free space are always one
+// contiguous region, and copying never needs to be split at the wrap
+// point. Capacity is rounded up to whole pages. Linux only, elsewhere
+// allocating memory throws. See supported().
+template< typename T >
+class MirroredRbuf
+{
+
+	static_assert(std::is_trivially_copyable< T >::value, "MirroredRbuf requires trivially copyable type!");
+
+public:
+
+	// Contiguous area of items inside the ring buffer
+	struct Region
+	{
+		T* begin;
+		size_t size;
+	};
+
+	inline MirroredRbuf();
+	inline ~MirroredRbuf();
+
+	// Returns true, if the platform supports mirrored memory
+	static inline bool supported();
+
+	inline void clear();
+	inline bool empty() const;
+	inline size_t size() const;
+	inline size_t capacity() const;
+	// Ensures there is space for at least "amount" items in total
+	inline void reserve(size_t amount);
+	// Returns how many times memory has been mapped since creation
+	inline size_t reallocations() const;
+
+	inline void insert(T const* begin, T const* end);
+	inline void read(T* result, size_t amount);
+
+	inline void push(T const& t);
+	inline T pop();
+
+	inline T front() const;
+
+	inline void swap(MirroredRbuf< T >& rbuf);
+
+	// Gets all readable items. The region stays
+	// valid until the buffer is modified.
+	inline Region readableRegion() const;
+	// Marks "amount" items from the start of readable region as read.
+	inline void consume(size_t amount);
+
+	// Ensures there is space for at least "min_amount"
+	// more items, and gets all the free space.
+	inline Region writableRegion(size_t min_amount = 0);
+	// Marks "amount" items from the start of writable region as written.
+	inline void commit(size_t amount);
+
+private:
+
+	size_t res;
+	size_t items;
+	size_t read_ofs;
+	T* buf;
+
+	size_t reallocation_count;
+
+	MirroredRbuf(MirroredRbuf< T > const&);
+	MirroredRbuf< T >& operator=(MirroredRbuf< T > const&);
+
+	inline void ensureSpace(size_t req);
+
+	// Maps "bytes" of memory twice. Returns pointer to the first mapping.
+	static inline T* mapMirrored(size_t bytes);
+	static inline void unmapMirrored(T* ptr, size_t bytes);
+	static inline size_t pageSize();
+
+};
+
+template< typename T >
+inline MirroredRbuf< T >::MirroredRbuf() :
+	res(0),
+	items(0),
+	read_ofs(0),
+	buf(NULL),
+	reallocation_count(0)
+{
+}
+
+template< typename T >
+inline MirroredRbuf< T >::~MirroredRbuf()
+{
+	if (res > 0) {
+		unmapMirrored(buf, res * sizeof(T));
+	}
+}
+
+template< typename T >
+inline bool MirroredRbuf< T >::supported()
+{
+#ifdef AGL_MIRRORED_RBUF_SUPPORTED
+	return true;
+#else
+	return false;
+#endif
+}
+
+template< typename T >
+inline void MirroredRbuf< T >::clear()
+{
+	if (res > 0) {
+		unmapMirrored(buf, res * sizeof(T));
+	}
+	res = 0;
+	items = 0;
+	read_ofs = 0;
+	buf = NULL;
+}
+
+template< typename T >
+inline bool MirroredRbuf< T >::empty() const
+{
+	return items == 0;
+}
+
+template< typename T >
+inline size_t MirroredRbuf< T >::size() const
+{
+	return items;
+}
+
+template< typename T >
+inline size_t MirroredRbuf< T >::capacity() const
+{
+	return res;
+}
+
+template< typename T >
+inline void MirroredRbuf< T >::reserve(size_t amount)
+{
+	ensureSpace(amount);
+}
+
+template< typename T >
+inline size_t MirroredRbuf< T >::reallocations() const
+{
+	return reallocation_count;
+}
+
+template< typename T >
+inline void MirroredRbuf< T >::insert(T const* begin, T const* end)
+{
+	if (begin == end) {
+		return;
+	}
+	size_t add = end - begin;
+	ensureSpace(items + add);
+	memcpy(buf + read_ofs + items, begin, add * sizeof(T));
+	items += add;
+}
+
+template< typename T >
+inline void MirroredRbuf< T >::read(T* result, size_t amount)
+{
+	if (amount == 0) return;
+	if (amount > items) {
+		throw std::runtime_error("Trying to read too much!");
+	}
+	memcpy(result, buf + read_ofs, amount * sizeof(T));
+	consume(amount);
+}
+
+template< typename T >
+inline void MirroredRbuf< T >::push(T const& t)
+{
+	ensureSpace(items + 1);
+	buf[read_ofs + items] = t;
+	items ++;
+}
+
+template< typename T >
+inline T MirroredRbuf< T >::pop()
+{
+	T result = buf[read_ofs];
+	consume(1);
+	return result;
+}
+
+template< typename T >
+inline T MirroredRbuf< T >::front() const
+{
+	return buf[read_ofs];
+}
+
+template< typename T >
+inline void MirroredRbuf< T >::swap(MirroredRbuf< T >& rbuf)
+{
+	size_t swap_res = rbuf.res;
+	size_t swap_items = rbuf.items;
+	size_t swap_read_ofs = rbuf.read_ofs;
+	T* swap_buf = rbuf.buf;
+	size_t swap_reallocation_count = rbuf.reallocation_count;
+
+	rbuf.res = res;
+	rbuf.items = items;
+	rbuf.read_ofs = read_ofs;
+	rbuf.buf = buf;
+	rbuf.reallocation_count = reallocation_count;
+
+	res = swap_res;
+	items = swap_items;
+	read_ofs = swap_read_ofs;
+	buf = swap_buf;
+	reallocation_count = swap_reallocation_count;
+}
+
+template< typename T >
+inline typename MirroredRbuf< T >::Region MirroredRbuf< T >::readableRegion() const
+{
+	Region region;
+	region.begin = buf + read_ofs;
+	region.size = items;
+	return region;
+}
+
+template< typename T >
+inline void MirroredRbuf< T >::consume(size_t amount)
+{
+	if (amount > items) {
+		throw std::runtime_error("Trying to consume too much!");
+	}
+	items -= amount;
+	read_ofs += amount;
+	if (read_ofs >= res) {
+		read_ofs -= res;
+	}
+}
+
+template< typename T >
+inline typename MirroredRbuf< T >::Region MirroredRbuf< T >::writableRegion(size_t min_amount)
+{
+	if (min_amount > 0) {
+		ensureSpace(items + min_amount);
+	}
+	Region region;
+	region.begin = buf + read_ofs + items;
+	region.size = res - items;
+	return region;
+}
+
+template< typename T >
+inline void MirroredRbuf< T >::commit(size_t amount)
+{
+	if (amount > res - items) {
+		throw std::runtime_error("Trying to commit too much!");
+	}
+	items += amount;
+}
+
+template< typename T >
+inline void MirroredRbuf< T >::ensureSpace(size_t req)
+{
+	if (res >= req) {
+		return;
+	}
+	// Grow from current capacity, so that
+	// repeated small insertions stay cheap.
+	size_t new_res = res * 2;
+	if (new_res < req) new_res = req;
+
+	if (!supported()) {
+		throw std::runtime_error("Mirrored ring buffer is supported only on Linux!");
+	}
+
+	// Mapping must consist of whole pages and whole items
+	size_t page_size = pageSize();
+	size_t unit = page_size;
+	while (unit % sizeof(T) != 0) {
+		unit += page_size;
+	}
+	size_t bytes = (new_res * sizeof(T) + unit - 1) / unit * unit;
+
+	T* newbuf = mapMirrored(bytes);
+	++ reallocation_count;
+	if (items > 0) {
+		memcpy(newbuf, buf + read_ofs, items * sizeof(T));
+	}
+	if (res > 0) {
+		unmapMirrored(buf, res * sizeof(T));
+	}
+	res = bytes / sizeof(T);
+	buf = newbuf;
+	read_ofs = 0;
+}
+
+template< typename T >
+inline T* MirroredRbuf< T >::mapMirrored(size_t bytes)
+{
+#ifdef AGL_MIRRORED_RBUF_SUPPORTED
+	int fd = memfd_create("agl_mirrored_rbuf", MFD_CLOEXEC);
+	if (fd < 0) {
+		throw std::runtime_error("Unable to create memory file for mirrored ring buffer!");
+	}
+	if (ftruncate(fd, bytes) != 0) {
+		close(fd);
+		throw std::bad_alloc();
+	}
+
+	// Reserve address space for both mappings, and then replace it
+	void* area = mmap(NULL, bytes * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (area == MAP_FAILED) {
+		close(fd);
+		throw std::bad_alloc();
+	}
+	uint8_t* area_bytes = (uint8_t*)area;
+	if (mmap(area_bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+	    mmap(area_bytes + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(area, bytes * 2);
+		close(fd);
+		throw std::bad_alloc();
+	}
+
+	// Mappings keep the memory alive
+	close(fd);
+
+	return (T*)area;
+#else
+	(void)bytes;
+	throw std::runtime_error("Mirrored ring buffer is supported only on Linux!");
+#endif
+}
+
+template< typename T >
+inline void MirroredRbuf< T >::unmapMirrored(T* ptr, size_t bytes)
+{
+#ifdef AGL_MIRRORED_RBUF_SUPPORTED
+	munmap(ptr, bytes * 2);
+#else
+	(void)ptr;
+	(void)bytes;
+#endif
+}
+
+template< typename T >
+inline size_t MirroredRbuf< T >::pageSize()
+{
+#ifdef AGL_MIRRORED_RBUF_SUPPORTED
+	return sysconf(_SC_PAGESIZE);
+#else
+	return 4096;
+#endif
+}
+
+}
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef AGL_PIPELINE_HPP
+#define AGL_PIPELINE_HPP
+
+#include "Stream.hpp"
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <stdint.h>
+
+namespace Agl
+{
+
+// Chain of Streams, where output of each stage is moved directly to the
+// input of the next one. Data that is pushed to the pipeline flows through
+// all stages, and can then be read from the last one. If stages have
+// buffering limits, data is held back in earlier stages until reading
+// makes room for it.
+class Pipeline
+{
+
+public:
+
+	inline Pipeline();
+
+	// Adds a stage to the end of pipeline. Stage is not owned by pipeline,
+	// and it must not be used directly while it is part of the pipeline.
+	inline void addStage(Stream& stage);
+
+	inline void push(const Bytes& bytes);
+	inline void push(const std::string& str);
+	inline void push(const char* bytes, uint64_t size);
+	inline void push(const struct iovec* iov, size_t iovcnt);
+
+	// Informs all stages, that all data is got.
+	inline void setEndOfData();
+
+	// Flushes all stages, so that everything pushed
+	// so far can be read from the last stage.
+	inline void flush();
+
+	// Functions to read data that has gone through all stages
+	inline Bytes readBytes(size_t limit = 0);
+	inline std::string readString(size_t limit = 0);
+	inline size_t readInto(uint8_t* result, size_t capacity);
+	inline size_t readInto(const struct iovec* iov, size_t iovcnt);
+
+private:
+
+	std::vector< Stream* > stages;
+
+	// Moves data through all stages, until nothing can move anymore
+	inline void flow();
+
+	inline Stream& lastStage();
+
+};
+
+inline Pipeline::Pipeline()
+{
+}
+
+inline void Pipeline::addStage(Stream& stage)
+{
+	stages.push_back(&stage);
+}
+
+inline void Pipeline::push(const Bytes& bytes)
+{
+	push((const char*)bytes.data(), bytes.size());
+}
+
+inline void Pipeline::push(const std::string& str)
+{
+	push(str.c_str(), str.size());
+}
+
+inline void Pipeline::push(const char* bytes, uint64_t size)
+{
+	if (stages.empty()) throw std::runtime_error("Pipeline has no stages!");
+	stages[0]->push(bytes, size);
+	flow();
+}
+
+inline void Pipeline::push(const struct iovec* iov, size_t iovcnt)
+{
+	if (stages.empty()) throw std::runtime_error("Pipeline has no stages!");
+	stages[0]->push(iov, iovcnt);
+	flow();
+}
+
+inline void Pipeline::setEndOfData()
+{
+	if (stages.empty()) throw std::runtime_error("Pipeline has no stages!");
+	stages[0]->setEndOfData();
+	flow();
+}
+
+inline void Pipeline::flush()
+{
+	if (stages.empty()) throw std::runtime_error("Pipeline has no stages!");
+	for (size_t stage_i = 0; stage_i < stages.size(); ++ stage_i) {
+		stages[stage_i]->flush();
+		if (stage_i + 1 < stages.size()) {
+			stages[stage_i]->pipeTo(*stages[stage_i + 1]);
+		}
+	}
+	flow();
+}
+
+inline Bytes Pipeline::readBytes(size_t limit)
+{
+	Bytes result = lastStage().readBytes(limit);
+	// Reading might have made room for data that was held back
+	flow();
+	return result;
+}
+
+inline std::string Pipeline::readString(size_t limit)
+{
+	std::string result = lastStage().readString(limit);
+	flow();
+	return result;
+}
+
+inline size_t Pipeline::readInto(uint8_t* result, size_t capacity)
+{
+	size_t amount = lastStage().readInto(result, capacity);
+	flow();
+	return amount;
+}
+
+inline size_t Pipeline::readInto(const struct iovec* iov, size_t iovcnt)
+{
+	size_t amount = lastStage().readInto(iov, iovcnt);
+	flow();
+	return amount;
+}
+
+inline void Pipeline::flow()
+{
+	// Room that a stage makes, or processing that it resumes, can let
+	// earlier stages move more data, so a single pass is not enough.
+	bool moved = true;
+	while (moved) {
+		moved = false;
+		for (size_t stage_i = 0; stage_i + 1 < stages.size(); ++ stage_i) {
+			if (stages[stage_i]->pipeTo(*stages[stage_i + 1])) {
+				moved = true;
+			}
+		}
+	}
+}
+
+inline Stream& Pipeline::lastStage()
+{
+	if (stages.empty()) throw std::runtime_error("Pipeline has no stages!");
+	return *stages.back();
+}
+
+}
+
+#endif
@@ -3,17 +3,30 @@
 
 #include <cstring>
 #include <cstdlib>
+#include <new>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 namespace Agl
 {
 
+// Ring buffer. Items live in raw storage and are constructed only when
+// they are added, so any movable type can be stored. Trivially copyable
+// types are moved around with memcpy.
 template< typename T >
 class Rbuf
 {
 
 public:
 
+	// Contiguous area of items inside the ring buffer
+	struct Region
+	{
+		T* begin;
+		size_t size;
+	};
+
 	inline Rbuf();
 	inline ~Rbuf();
 
@@ -21,51 +34,133 @@ public:
 	inline bool empty() const;
 	inline size_t size() const;
 
+	// Memory management. Capacity grows by "growth_factor" times the
+	// current capacity. If "shrink_factor" is not zero, capacity is halved
+	// whenever items fill only 1/shrink_factor of it. Shrinking happens
+	// only down to "min_capacity". New buffer has 0, 2 and 0, so it never
+	// shrinks by itself. Note that the default argument of "shrink_factor"
+	// differs from that, so calling this turns shrinking on by default.
+	inline void setCapacityPolicy(size_t min_capacity, size_t growth_factor = 2, size_t shrink_factor = 4);
+	// Ensures there is space for at least "amount" items in total
+	inline void reserve(size_t amount);
+	// Reduces capacity to current amount of items, or to minimum capacity
+	inline void shrinkToFit();
+	inline size_t capacity() const;
+	// Returns maximum amount of items stored since creation or reset
+	inline size_t highWatermark() const;
+	inline void resetHighWatermark();
+	// Returns how many times storage has been allocated since creation
+	inline size_t reallocations() const;
+
 	inline void insert(T const* begin, T const* end);
+	// Moves items to already constructed objects at "result"
 	inline void read(T* result, size_t amount);
 
 	inline void push(T const& t);
+	inline void push(T&& t);
+	// Constructs new item in place
+	template< typename... Args >
+	inline void emplace(Args&&... args);
 	inline T pop();
 
-	inline T front() const;
+	inline T const& front() const;
+	inline T& front();
 
 	inline void swap(Rbuf< T >& rbuf);
 
+	// Gets readable items as one or two contiguous regions, in reading
+	// order. Returns the number of non-empty regions. The regions stay
+	// valid until the buffer is modified.
+	inline size_t readableRegions(Region& first, Region& second) const;
+	// Marks "amount" items from the start of readable regions as read.
+	inline void consume(size_t amount);
+
+	// Ensures there is space for at least "min_amount" more items, and
+	// gets the free space as one or two contiguous regions, in writing
+	// order. Returns the number of non-empty regions. Because free space
+	// is raw memory, this is available only for trivially copyable types.
+	inline size_t writableRegions(Region& first, Region& second, size_t min_amount = 0);
+	// Marks "amount" items from the start of writable regions as written.
+	inline void commit(size_t amount);
+
 private:
 
+	typedef std::integral_constant< bool, std::is_trivially_copyable< T >::value > Trivial;
+
 	size_t res;
 	size_t items;
 	T* write_pos;
 	T* read_pos;
 	T* buf;
 
+	size_t min_res;
+	size_t growth_factor;
+	size_t shrink_factor;
+	size_t high_watermark;
+	size_t reallocation_count;
+
+	Rbuf(Rbuf< T > const&);
+	Rbuf< T >& operator=(Rbuf< T > const&);
+
 	inline void ensureSpace(size_t req);
+	inline void reduceSpace();
+	// Moves items to new buffer of exactly "new_res" items
+	inline void reallocate(size_t new_res);
+	// Moves write position forward after a single item has been constructed
+	inline void pushed();
+
+	// Copies items to raw memory
+	static inline void copyItems(T* dest, T const* src, size_t amount, std::true_type);
+	static inline void copyItems(T* dest, T const* src, size_t amount, std::false_type);
+	// Moves items to raw memory, and destroys the originals
+	static inline void moveItems(T* dest, T* src, size_t amount, std::true_type);
+	static inline void moveItems(T* dest, T* src, size_t amount, std::false_type);
+	// Moves items to constructed objects, and destroys the originals
+	static inline void moveOutItems(T* dest, T* src, size_t amount, std::true_type);
+	static inline void moveOutItems(T* dest, T* src, size_t amount, std::false_type);
+	static inline void destroyItems(T* begin, size_t amount, std::true_type);
+	static inline void destroyItems(T* begin, size_t amount, std::false_type);
 
 };
 
 template< typename T >
 inline Rbuf< T >::Rbuf() :
 	res(0),
-	items(0)
+	items(0),
+	write_pos(NULL),
+	read_pos(NULL),
+	buf(NULL),
+	min_res(0),
+	growth_factor(2),
+	shrink_factor(0),
+	high_watermark(0),
+	reallocation_count(0)
 {
 }
 
 template< typename T >
 inline Rbuf< T >::~Rbuf()
 {
-	if (res > 0) {
-		delete[] buf;
-	}
+	clear();
 }
 
 template< typename T >
 inline void Rbuf< T >::clear()
 {
+	if (items > 0) {
+		Region first, second;
+		readableRegions(first, second);
+		destroyItems(first.begin, first.size, Trivial());
+		destroyItems(second.begin, second.size, Trivial());
+	}
 	if (res > 0) {
-		delete[] buf;
+		::operator delete(buf);
 	}
 	res = 0;
 	items = 0;
+	write_pos = NULL;
+	read_pos = NULL;
+	buf = NULL;
 }
 
 template< typename T >
@@ -80,6 +175,62 @@ inline size_t Rbuf< T >::size() const
 	return items;
 }
 
+template< typename T >
+inline void Rbuf< T >::setCapacityPolicy(size_t min_capacity, size_t growth_factor, size_t shrink_factor)
+{
+	if (growth_factor < 2) {
+		throw std::runtime_error("Growth factor must be at least two!");
+	}
+	if (shrink_factor != 0 && shrink_factor <= growth_factor) {
+		throw std::runtime_error("Shrink factor must be bigger than growth factor!");
+	}
+	min_res = min_capacity;
+	this->growth_factor = growth_factor;
+	this->shrink_factor = shrink_factor;
+	reduceSpace();
+}
+
+template< typename T >
+inline void Rbuf< T >::reserve(size_t amount)
+{
+	if (res < amount) {
+		reallocate(amount);
+	}
+}
+
+template< typename T >
+inline void Rbuf< T >::shrinkToFit()
+{
+	size_t new_res = items > min_res ? items : min_res;
+	if (new_res < res) {
+		reallocate(new_res);
+	}
+}
+
+template< typename T >
+inline size_t Rbuf< T >::capacity() const
+{
+	return res;
+}
+
+template< typename T >
+inline size_t Rbuf< T >::highWatermark() const
+{
+	return high_watermark;
+}
+
+template< typename T >
+inline void Rbuf< T >::resetHighWatermark()
+{
+	high_watermark = items;
+}
+
+template< typename T >
+inline size_t Rbuf< T >::reallocations() const
+{
+	return reallocation_count;
+}
+
 template< typename T >
 inline void Rbuf< T >::insert(T const* begin, T const* end)
 {
@@ -90,17 +241,21 @@ inline void Rbuf< T >::insert(T const* begin, T const* end)
 	size_t add = end - begin;
 	ensureSpace(items + add);
 	if (write_pos + add <= buf + res) {
-		memcpy(write_pos, begin, add * sizeof(T));
+		copyItems(write_pos, begin, add, Trivial());
 		write_pos += add;
+		if (write_pos == buf + res) {
+			write_pos = buf;
+		}
 	} else {
 		size_t amount = buf + res - write_pos;
-		memcpy(write_pos, begin, amount * sizeof(T));
+		copyItems(write_pos, begin, amount, Trivial());
 		//assert(add >= amount, "Fail!");
 		size_t amount2 = add - amount;
-		memcpy(buf, begin + amount, amount2 * sizeof(T));
+		copyItems(buf, begin + amount, amount2, Trivial());
 		write_pos = buf + amount2;
 	}
 	items += add;
+	if (items > high_watermark) high_watermark = items;
 }
 
 template< typename T >
@@ -112,35 +267,44 @@ inline void Rbuf< T >::read(T* result, size_t amount)
 	}
 	// If everything can be read using one copy
 	if (read_pos < write_pos || size_t(buf + res - read_pos) >= amount) {
-		memcpy(result, read_pos, amount * sizeof(T));
+		moveOutItems(result, read_pos, amount, Trivial());
 		read_pos += amount;
 		if (read_pos == buf + res) {
 			read_pos = buf;
 		}
 		items -= amount;
-// TODO: Check if it would be good idea to reduce space!
 	}
 	// We need two read steps
 	else {
 		size_t first_copy_amount = buf + res - read_pos;
-		memcpy(result, read_pos, first_copy_amount * sizeof(T));
-		memcpy(result + first_copy_amount, buf, (amount - first_copy_amount) * sizeof(T));
+		moveOutItems(result, read_pos, first_copy_amount, Trivial());
+		moveOutItems(result + first_copy_amount, buf, amount - first_copy_amount, Trivial());
 		items -= amount;
 		read_pos = buf + amount - first_copy_amount;
 	}
+	reduceSpace();
 }
 
 template< typename T >
 inline void Rbuf< T >::push(T const& t)
+{
+	emplace(t);
+}
+
+template< typename T >
+inline void Rbuf< T >::push(T&& t)
+{
+	emplace(std::move(t));
+}
+
+template< typename T >
+template< typename... Args >
+inline void Rbuf< T >::emplace(Args&&... args)
 {
 	ensureSpace(items + 1);
 	//assert(write_pos != buf + res, "Write points to the end of buffer!");
-	*write_pos = t;
-	write_pos ++;
-	if (write_pos == buf + res) {
-		write_pos = buf;
-	}
-	items ++;
+	new (write_pos) T(std::forward< Args >(args)...);
+	pushed();
 }
 
 template< typename T >
@@ -148,18 +312,26 @@ inline T Rbuf< T >::pop()
 {
 	//assert(items > 0, "Queue is empty!");
 	//assert(read_pos != buf + res, "Fail!");
-	T result = *read_pos;
+	T result(std::move(*read_pos));
+	read_pos->~T();
 	read_pos ++;
 	if (read_pos == buf + res) {
 		read_pos = buf;
 	}
 	items --;
-// TODO: Check if it would be good idea to reduce space!
+	reduceSpace();
 	return result;
 }
 
 template< typename T >
-inline T Rbuf< T >::front() const
+inline T const& Rbuf< T >::front() const
+{
+	//assert(items > 0, "No items!");
+	return *read_pos;
+}
+
+template< typename T >
+inline T& Rbuf< T >::front()
 {
 	//assert(items > 0, "No items!");
 	return *read_pos;
@@ -173,18 +345,120 @@ inline void Rbuf< T >::swap(Rbuf< T >& rbuf)
 	T* swap_write_pos = rbuf.write_pos;
 	T* swap_read_pos = rbuf.read_pos;
 	T* swap_buf = rbuf.buf;
+	size_t swap_min_res = rbuf.min_res;
+	size_t swap_growth_factor = rbuf.growth_factor;
+	size_t swap_shrink_factor = rbuf.shrink_factor;
+	size_t swap_high_watermark = rbuf.high_watermark;
+	size_t swap_reallocation_count = rbuf.reallocation_count;
 
 	rbuf.res = res;
 	rbuf.items = items;
 	rbuf.write_pos = write_pos;
 	rbuf.read_pos = read_pos;
 	rbuf.buf = buf;
+	rbuf.min_res = min_res;
+	rbuf.growth_factor = growth_factor;
+	rbuf.shrink_factor = shrink_factor;
+	rbuf.high_watermark = high_watermark;
+	rbuf.reallocation_count = reallocation_count;
 
 	res = swap_res;
 	items = swap_items;
 	write_pos = swap_write_pos;
 	read_pos = swap_read_pos;
 	buf = swap_buf;
+	min_res = swap_min_res;
+	growth_factor = swap_growth_factor;
+	shrink_factor = swap_shrink_factor;
+	high_watermark = swap_high_watermark;
+	reallocation_count = swap_reallocation_count;
+}
+
+template< typename T >
+inline size_t Rbuf< T >::readableRegions(Region& first, Region& second) const
+{
+	second.begin = buf;
+	second.size = 0;
+	if (items == 0) {
+		first.begin = read_pos;
+		first.size = 0;
+		return 0;
+	}
+	first.begin = read_pos;
+	if (read_pos + items <= buf + res) {
+		first.size = items;
+		return 1;
+	}
+	first.size = buf + res - read_pos;
+	second.size = items - first.size;
+	return 2;
+}
+
+template< typename T >
+inline void Rbuf< T >::consume(size_t amount)
+{
+	if (amount > items) {
+		throw std::runtime_error("Trying to consume too much!");
+	}
+	if (!Trivial::value && amount > 0) {
+		size_t first_amount = buf + res - read_pos;
+		if (first_amount > amount) first_amount = amount;
+		destroyItems(read_pos, first_amount, Trivial());
+		destroyItems(buf, amount - first_amount, Trivial());
+	}
+	items -= amount;
+	// When buffer gets empty, start from the beginning
+	// again, so free space is contiguous as possible.
+	if (items == 0) {
+		read_pos = buf;
+		write_pos = buf;
+	} else {
+		read_pos += amount;
+		if (read_pos >= buf + res) {
+			read_pos -= res;
+		}
+	}
+	reduceSpace();
+}
+
+template< typename T >
+inline size_t Rbuf< T >::writableRegions(Region& first, Region& second, size_t min_amount)
+{
+	static_assert(Trivial::value, "Writable regions require trivially copyable type!");
+	if (min_amount > 0) {
+		ensureSpace(items + min_amount);
+	}
+	second.begin = buf;
+	second.size = 0;
+	first.begin = write_pos;
+	size_t free_space = res - items;
+	if (free_space == 0) {
+		first.size = 0;
+		return 0;
+	}
+	if (write_pos + free_space <= buf + res) {
+		first.size = free_space;
+		return 1;
+	}
+	first.size = buf + res - write_pos;
+	second.size = free_space - first.size;
+	return 2;
+}
+
+template< typename T >
+inline void Rbuf< T >::commit(size_t amount)
+{
+	static_assert(Trivial::value, "Writable regions require trivially copyable type!");
+	if (amount > res - items) {
+		throw std::runtime_error("Trying to commit too much!");
+	}
+	if (amount == 0) return;
+	write_pos += amount;
+	if (write_pos >= buf + res) {
+		write_pos -= res;
+	}
+	items += amount;
+	if (items > high_watermark) high_watermark = items;
 }
 
 template< typename T >
@@ -193,27 +467,133 @@ inline void Rbuf< T >::ensureSpace(size_t req)
 	if (res >= req) {
 		return;
 	}
-	req *= 2;
-	T* newbuf = new T[req];
+	size_t new_res = res * growth_factor;
+	if (new_res < req) new_res = req;
+	if (new_res < min_res) new_res = min_res;
+	reallocate(new_res);
+}
+
+template< typename T >
+inline void Rbuf< T >::reduceSpace()
+{
+	if (shrink_factor == 0 || res <= min_res) {
+		return;
+	}
+	if (items * shrink_factor > res) {
+		return;
+	}
+	// Leave enough room, so the next few insertions
+	// do not need to grow the buffer immediately again.
+	size_t new_res = res / 2;
+	if (new_res < items * 2) new_res = items * 2;
+	if (new_res < min_res) new_res = min_res;
+	if (new_res < res) {
+		reallocate(new_res);
+	}
+}
+
+template< typename T >
+inline void Rbuf< T >::reallocate(size_t new_res)
+{
+	//assert(new_res >= items, "Too small buffer!");
+	if (new_res == 0) {
+		clear();
+		return;
+	}
+	T* newbuf = static_cast< T* >(::operator new(new_res * sizeof(T)));
+	++ reallocation_count;
 	if (items > 0) {
 		if (read_pos < write_pos || write_pos == buf) {
 			//assert(read_pos + items <= buf + res, "Overflow!");
-			memcpy(newbuf, read_pos, items * sizeof(T));
+			moveItems(newbuf, read_pos, items, Trivial());
 		} else {
 			size_t amount = buf + res - read_pos;
-			memcpy(newbuf, read_pos, amount * sizeof(T));
+			moveItems(newbuf, read_pos, amount, Trivial());
 			//assert(items >= amount, "Fail!");
 			size_t amount2 = items - amount;
-			memcpy(newbuf + amount, buf, amount2 * sizeof(T));
+			moveItems(newbuf + amount, buf, amount2, Trivial());
 		}
 	}
 	if (res > 0) {
-		delete[] buf;
+		::operator delete(buf);
 	}
-	res = req;
+	res = new_res;
 	buf = newbuf;
 	read_pos = newbuf;
 	write_pos = newbuf + items;
+	if (write_pos == newbuf + new_res) {
+		write_pos = newbuf;
+	}
+}
+
+template< typename T >
+inline void Rbuf< T >::pushed()
+{
+	write_pos ++;
+	if (write_pos == buf + res) {
+		write_pos = buf;
+	}
+	items ++;
+	if (items > high_watermark) high_watermark = items;
+}
+
+template< typename T >
+inline void Rbuf< T >::copyItems(T* dest, T const* src, size_t amount, std::true_type)
+{
+	memcpy(dest, src, amount * sizeof(T));
+}
+
+template< typename T >
+inline void Rbuf< T >::copyItems(T* dest, T const* src, size_t amount, std::false_type)
+{
+	for (size_t i = 0; i < amount; ++ i) {
+		new (dest + i) T(src[i]);
+	}
+}
+
+template< typename T >
+inline void Rbuf< T >::moveItems(T* dest, T* src, size_t amount, std::true_type)
+{
+	memcpy(dest, src, amount * sizeof(T));
+}
+
+template< typename T >
+inline void Rbuf< T >::moveItems(T* dest, T* src, size_t amount, std::false_type)
+{
+	for (size_t i = 0; i < amount; ++ i) {
+		new (dest + i) T(std::move(src[i]));
+		src[i].~T();
+	}
+}
+
+template< typename T >
+inline void Rbuf< T >::moveOutItems(T* dest, T* src, size_t amount, std::true_type)
+{
+	memcpy(dest, src, amount * sizeof(T));
+}
+
+template< typename T >
+inline void Rbuf< T >::moveOutItems(T* dest, T* src, size_t amount, std::false_type)
+{
+	for (size_t i = 0; i < amount; ++ i) {
+		dest[i] = std::move(src[i]);
+		src[i].~T();
+	}
+}
+
+template< typename T >
+inline void Rbuf< T >::destroyItems(T* begin, size_t amount, std::true_type)
+{
+	(void)begin;
+	(void)amount;
+}
+
+template< typename T >
+inline void Rbuf< T >::destroyItems(T* begin, size_t amount, std::false_type)
+{
+	for (size_t i = 0; i < amount; ++ i) {
+		begin[i].~T();
+	}
 }
 
 }
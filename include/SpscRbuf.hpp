@@ -0,0 +1,316 @@
+#ifndef AGL_SPSCRBUF_HPP
+#define AGL_SPSCRBUF_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <cstring>
+#include <cstdlib>
+#include <stdexcept>
+#include <type_traits>
+
+namespace Agl
+{
+
+// Fixed capacity ring buffer for exactly one producer thread and exactly
+// one consumer thread. Items are passed without locking. In blocking mode,
+// the other side is woken up only when it is actually sleeping, so the
+// mutex is not touched while both threads keep up with each other.
+template< typename T >
+class SpscRbuf
+{
+
+	static_assert(std::is_trivially_copyable< T >::value, "SpscRbuf requires trivially copyable type!");
+
+public:
+
+	// Capacity is rounded up to next power of two.
+	inline SpscRbuf(size_t capacity, bool blocking = false);
+	inline ~SpscRbuf();
+
+	inline size_t capacity() const;
+	// These are only snapshots, when other thread is active
+	inline size_t size() const;
+	inline bool empty() const;
+
+	// Producer side. Inserts as many items as fit and returns their amount.
+	inline size_t insert(T const* begin, T const* end);
+	// Producer side. Waits until all items are inserted. Requires blocking
+	// mode. Returns false if buffer was closed before everything fitted.
+	inline bool insertAll(T const* begin, T const* end);
+	// Producer side. Waits until there are at most "max_size" items left.
+	// Requires blocking mode. Returns false if buffer was closed.
+	inline bool waitForSize(size_t max_size);
+
+	// Consumer side. Reads at most "amount" items and returns their amount.
+	inline size_t read(T* result, size_t amount);
+	// Consumer side. Waits until there is at least one item available.
+	// Requires blocking mode. Returns zero only if buffer is closed and
+	// everything has been read.
+	inline size_t readWait(T* result, size_t amount);
+	// Consumer side. Waits until there is at least one item available, or
+	// buffer is closed. Requires blocking mode. Returns amount of items.
+	inline size_t waitForItems();
+
+	// Informs that no more items will be inserted. Wakes up both sides.
+	inline void close();
+	inline bool closed() const;
+
+private:
+
+	static size_t const CACHE_LINE_SIZE = 64;
+
+	// Consumer owned
+	alignas(CACHE_LINE_SIZE) std::atomic< size_t > head;
+	size_t cached_tail;
+
+	// Producer owned
+	alignas(CACHE_LINE_SIZE) std::atomic< size_t > tail;
+	size_t cached_head;
+
+	// Read only after construction
+	alignas(CACHE_LINE_SIZE) T* buf;
+	size_t res;
+	size_t mask;
+	bool blocking;
+
+	// Used only when some side needs to sleep
+	alignas(CACHE_LINE_SIZE) std::atomic< bool > producer_waiting;
+	std::atomic< bool > consumer_waiting;
+	std::atomic< bool > is_closed;
+	std::mutex wait_mutex;
+	std::condition_variable wait_cond;
+
+	SpscRbuf(SpscRbuf< T > const&);
+	SpscRbuf< T >& operator=(SpscRbuf< T > const&);
+
+	inline void wakeUp(std::atomic< bool >& waiting);
+
+};
+
+template< typename T >
+inline SpscRbuf< T >::SpscRbuf(size_t capacity, bool blocking) :
+	head(0),
+	cached_tail(0),
+	tail(0),
+	cached_head(0),
+	res(1),
+	blocking(blocking),
+	producer_waiting(false),
+	consumer_waiting(false),
+	is_closed(false)
+{
+	if (capacity == 0) {
+		throw std::runtime_error("SpscRbuf capacity must be positive!");
+	}
+	while (res < capacity) {
+		res *= 2;
+	}
+	mask = res - 1;
+	buf = new T[res];
+}
+
+template< typename T >
+inline SpscRbuf< T >::~SpscRbuf()
+{
+	delete[] buf;
+}
+
+template< typename T >
+inline size_t SpscRbuf< T >::capacity() const
+{
+	return res;
+}
+
+template< typename T >
+inline size_t SpscRbuf< T >::size() const
+{
+	size_t h = head.load(std::memory_order_acquire);
+	size_t t = tail.load(std::memory_order_acquire);
+	return t - h;
+}
+
+template< typename T >
+inline bool SpscRbuf< T >::empty() const
+{
+	return size() == 0;
+}
+
+template< typename T >
+inline size_t SpscRbuf< T >::insert(T const* begin, T const* end)
+{
+	size_t t = tail.load(std::memory_order_relaxed);
+	size_t amount = end - begin;
+	// Refresh the view of consumer only if cached one seems to be full
+	if (res - (t - cached_head) < amount) {
+		cached_head = head.load(std::memory_order_acquire);
+	}
+	size_t free_space = res - (t - cached_head);
+	if (amount > free_space) amount = free_space;
+	if (amount == 0) return 0;
+
+	size_t ofs = t & mask;
+	size_t first_copy_amount = res - ofs;
+	if (first_copy_amount >= amount) {
+		memcpy(buf + ofs, begin, amount * sizeof(T));
+	} else {
+		memcpy(buf + ofs, begin, first_copy_amount * sizeof(T));
+		memcpy(buf, begin + first_copy_amount, (amount - first_copy_amount) * sizeof(T));
+	}
+	tail.store(t + amount, std::memory_order_release);
+
+	if (blocking) {
+		wakeUp(consumer_waiting);
+	}
+	return amount;
+}
+
+template< typename T >
+inline bool SpscRbuf< T >::insertAll(T const* begin, T const* end)
+{
+	if (!blocking) {
+		throw std::runtime_error("SpscRbuf is not in blocking mode!");
+	}
+	while (begin < end) {
+		if (is_closed.load(std::memory_order_acquire)) {
+			return false;
+		}
+		size_t inserted = insert(begin, end);
+		begin += inserted;
+		if (inserted == 0) {
+			std::unique_lock< std::mutex > lock(wait_mutex);
+			producer_waiting.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			while (tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire) == res &&
+			       !is_closed.load(std::memory_order_acquire)) {
+				wait_cond.wait(lock);
+			}
+			producer_waiting.store(false, std::memory_order_relaxed);
+		}
+	}
+	return true;
+}
+
+template< typename T >
+inline bool SpscRbuf< T >::waitForSize(size_t max_size)
+{
+	if (!blocking) {
+		throw std::runtime_error("SpscRbuf is not in blocking mode!");
+	}
+	std::unique_lock< std::mutex > lock(wait_mutex);
+	producer_waiting.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	while (tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire) > max_size &&
+	       !is_closed.load(std::memory_order_acquire)) {
+		wait_cond.wait(lock);
+	}
+	producer_waiting.store(false, std::memory_order_relaxed);
+	return !is_closed.load(std::memory_order_acquire);
+}
+
+template< typename T >
+inline size_t SpscRbuf< T >::read(T* result, size_t amount)
+{
+	size_t h = head.load(std::memory_order_relaxed);
+	// Refresh the view of producer only if cached one seems to be empty
+	if (cached_tail - h < amount) {
+		cached_tail = tail.load(std::memory_order_acquire);
+	}
+	size_t available = cached_tail - h;
+	if (amount > available) amount = available;
+	if (amount == 0) return 0;
+
+	size_t ofs = h & mask;
+	size_t first_copy_amount = res - ofs;
+	if (first_copy_amount >= amount) {
+		memcpy(result, buf + ofs, amount * sizeof(T));
+	} else {
+		memcpy(result, buf + ofs, first_copy_amount * sizeof(T));
+		memcpy(result + first_copy_amount, buf, (amount - first_copy_amount) * sizeof(T));
+	}
+	head.store(h + amount, std::memory_order_release);
+
+	if (blocking) {
+		wakeUp(producer_waiting);
+	}
+	return amount;
+}
+
+template< typename T >
+inline size_t SpscRbuf< T >::readWait(T* result, size_t amount)
+{
+	if (!blocking) {
+		throw std::runtime_error("SpscRbuf is not in blocking mode!");
+	}
+	if (amount == 0) return 0;
+	while (true) {
+		size_t readed = read(result, amount);
+		if (readed > 0) {
+			return readed;
+		}
+		std::unique_lock< std::mutex > lock(wait_mutex);
+		consumer_waiting.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		while (tail.load(std::memory_order_acquire) == head.load(std::memory_order_relaxed)) {
+			if (is_closed.load(std::memory_order_acquire)) {
+				consumer_waiting.store(false, std::memory_order_relaxed);
+				// Producer might have inserted something just before closing
+				lock.unlock();
+				return read(result, amount);
+			}
+			wait_cond.wait(lock);
+		}
+		consumer_waiting.store(false, std::memory_order_relaxed);
+	}
+}
+
+template< typename T >
+inline size_t SpscRbuf< T >::waitForItems()
+{
+	if (!blocking) {
+		throw std::runtime_error("SpscRbuf is not in blocking mode!");
+	}
+	size_t available = size();
+	if (available > 0) {
+		return available;
+	}
+	std::unique_lock< std::mutex > lock(wait_mutex);
+	consumer_waiting.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	while (tail.load(std::memory_order_acquire) == head.load(std::memory_order_relaxed) &&
+	       !is_closed.load(std::memory_order_acquire)) {
+		wait_cond.wait(lock);
+	}
+	consumer_waiting.store(false, std::memory_order_relaxed);
+	return size();
+}
+
+template< typename T >
+inline void SpscRbuf< T >::close()
+{
+	is_closed.store(true, std::memory_order_release);
+	std::lock_guard< std::mutex > lock(wait_mutex);
+	wait_cond.notify_all();
+}
+
+template< typename T >
+inline bool SpscRbuf< T >::closed() const
+{
+	return is_closed.load(std::memory_order_acquire);
+}
+
+template< typename T >
+inline void SpscRbuf< T >::wakeUp(std::atomic< bool >& waiting)
+{
+	// Pairs with the fence that sleeping side does after raising its flag.
+	// Either this sees the flag, or the other side sees the new index.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (waiting.load(std::memory_order_relaxed)) {
+		std::lock_guard< std::mutex > lock(wait_mutex);
+		wait_cond.notify_all();
+	}
+}
+
+}
+
+#endif
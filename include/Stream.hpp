@@ -2,12 +2,31 @@
 #define AGL_STREAM_HPP
 
 #include "Bytes.hpp"
-#include "Rbuf.hpp"
+#include "ChunkBuf.hpp"
+#include "StreamBuffer.hpp"
+#include "StreamStats.hpp"
 
 #include <string>
 #include <stdexcept>
 #include <cstring>
 #include <stdint.h>
+#include <cerrno>
+#ifdef _WIN32
+// Same layout as the POSIX one, so that
+// scattered buffers can be used everywhere.
+struct iovec
+{
+	void* iov_base;
+	size_t iov_len;
+};
+#else
+#include <sys/uio.h>
+#endif
+#ifdef AGL_STREAM_STATS
+#include <chrono>
+#include <mutex>
+#include <set>
+#endif
 
 namespace Agl
 {
@@ -25,19 +44,98 @@ public:
 		inline virtual const char* what() const throw () { return "Stream input already closed!"; }
 	};
 
+	class StreamInputFull : public std::runtime_error
+	{
+	public:
+		inline StreamInputFull() : std::runtime_error("Stream input buffer is full!") { }
+		inline virtual ~StreamInputFull() throw () { }
+		inline virtual const char* what() const throw () { return "Stream input buffer is full!"; }
+	};
+
 	inline Stream();
-	inline ~Stream();
+	inline virtual ~Stream();
 
 	inline void push(const Bytes& bytes);
 	inline void push(const std::string& str);
 	inline void push(const char* bytes, uint64_t size);
+	// Pushes multiple separate buffers as if they were one
+	inline void push(const struct iovec* iov, size_t iovcnt);
+	// Pushes data without copying it, if chunked storage is used
+	inline void push(Bytes&& bytes);
+	inline void push(ChunkBuf& chunks);
 
 	// Informs stream, that all data is got. No more data will be pushed.
 	inline void setEndOfData();
 
+	// Makes Stream output all data that has been pushed so far, if it
+	// normally holds some of it back, like compressors do. This lets the
+	// receiver process everything right away, at some cost of efficiency.
+	inline void flush();
+
+	// Drops all data and makes Stream ready for new data, as if it
+	// was just created. Limits, storage and allocated memory are kept,
+	// so reusing a Stream is cheaper than creating a new one.
+	inline void reset();
+
 	// Functions to read data that Stream has processed
 	inline Bytes readBytes(size_t limit = 0);
 	inline std::string readString(size_t limit = 0);
+	// Functions to read processed data to buffers of caller.
+	// Return amount of bytes that were read.
+	inline size_t readInto(uint8_t* result, size_t capacity);
+	inline size_t readInto(const struct iovec* iov, size_t iovcnt);
+	// Reads processed data as chunks. If chunked storage is used,
+	// then the blocks are shared instead of copying the data.
+	inline ChunkBuf readChunks(size_t limit = 0);
+#ifndef _WIN32
+	// Writes processed data to file descriptor. Returns amount of bytes
+	// that were written, which is zero if non-blocking descriptor is full.
+	inline size_t writeTo(int fd);
+#endif
+
+	// Moves processed data directly to the input of another Stream, as
+	// much as its input limit allows. When this Stream has processed
+	// everything after end of data, end of data is set to "target" too.
+	// Returns true, if any data or end of data was passed.
+	inline bool pipeTo(Stream& target);
+
+	// Limits buffering of processed data. When output has "high" bytes or
+	// more, processing is paused, and pushed data is only buffered. Reading
+	// resumes processing, once output has been drained to "low" bytes.
+	// Zero "high" means unlimited, which is the default.
+	inline void setOutputLimits(size_t high, size_t low);
+	// Limits buffering of unprocessed data. Pushing data that does not fit
+	// throws StreamInputFull. Zero means unlimited, which is the default.
+	inline void setInputLimit(size_t limit);
+	// Returns true, if processing is paused until output is read
+	inline bool isOutputFull() const;
+	// Returns amount of processed data that is ready to be read
+	inline size_t outputSize() const;
+
+	// Makes input and output use chains of reference counted blocks
+	// instead of ring buffers. Growing is then cheap, and data can be
+	// passed in and out without copying. Must be called before pushing.
+	inline void setChunkedStorage(size_t block_size = 64 * 1024);
+	// Makes input and output use ring buffers whose memory is mapped twice,
+	// so buffered data is never split at the wrap point. Subclasses, like
+	// Deflator, then get all input as one region. Linux only, elsewhere
+	// this throws. Must be called before pushing.
+	inline void setMirroredStorage();
+
+	// Memory management of input and output buffers. See Rbuf.
+	inline void setCapacityPolicy(size_t min_capacity, size_t growth_factor = 2, size_t shrink_factor = 4);
+	inline void shrinkToFit();
+	// Total capacity and peak usage of input and output buffers, in bytes
+	inline size_t capacity() const;
+	inline size_t highWatermark() const;
+
+	// Returns usage figures of this Stream. See StreamStats.
+	inline StreamStats stats() const;
+	// Resets byte and call counters
+	inline void resetStats();
+	// Returns sum of figures of all Streams that currently exist.
+	// Returns empty figures, if AGL_STREAM_STATS is not defined.
+	static inline StreamStats aggregateStats();
 
 protected:
 
@@ -49,34 +147,103 @@ protected:
 	// Writes to outputdata
 	inline void writeOutputData(uint8_t* begin, uint8_t* end);
 
+	// Returns true, if output has reached its limit. Subclasses should
+	// stop processing then, and continue when new data is available.
+	inline bool outputFull() const;
+
+	// Direct access to input data. Gets the first contiguous chunk
+	// of unhandled input data and returns its size. The chunk stays
+	// valid until input data is consumed or new data is pushed.
+	inline size_t viewInputData(uint8_t const*& begin) const;
+	// Marks bytes from the start of input data as handled.
+	inline void consumeInputData(size_t amount);
+	inline size_t inputDataSize() const;
+
+	// Direct access to output buffer. Ensures there is free space for at
+	// least "min_size" bytes, and gets the first contiguous chunk of it.
+	// Returns size of the chunk, which may be smaller than "min_size".
+	// If output is limited, the chunk is cut to the room that is left,
+	// but never below "min_size".
+	inline size_t reserveOutputData(uint8_t*& begin, size_t min_size);
+	// Marks bytes from the start of reserved chunk as written.
+	inline void commitOutputData(size_t amount);
+
 private:
 
-	Rbuf< uint8_t > input;
-	Rbuf< uint8_t > output;
+	StreamBuffer input;
+	StreamBuffer output;
 
 	bool end_of_data;
 
-	// Ensures there is specific amount of unused space in ring buffer
-	inline void ensureEmptySpace(uint64_t size);
+	size_t input_limit;
+	size_t output_high;
+	size_t output_low;
+	bool processing_paused;
+
+	// Exists even if AGL_STREAM_STATS is not
+	// defined, so that the layout stays the same.
+	StreamCounters counters;
+
+#ifdef AGL_STREAM_STATS
+	// Streams that currently exist, for aggregating their figures
+	struct Registry
+	{
+		std::mutex mutex;
+		std::set< Stream const* > streams;
+	};
+	static inline Registry& registry();
+#endif
+
+	// Lets subclass process data, unless output is full
+	inline void process();
+	// Continues processing, if output has been drained enough
+	inline void resumeProcessing();
+
+	// Throws if "size" more bytes do not fit to input
+	inline void checkInputRoom(size_t size) const;
+	// Copies data from output. Returns amount that was copied.
+	inline size_t copyOutput(uint8_t* result, size_t amount);
 
 	// This virtual function informs subclass when there is
 	// new data available, or when end of data has been set.
 	virtual void newDataAvailable(uint64_t amount, bool end_of_data) = 0;
 
+	// This virtual function informs subclass that Stream has been reset.
+	// Subclass should return to the state it had after construction.
+	inline virtual void resetRequested();
+
+	// This virtual function informs subclass that flush() has been called.
+	// Flushing should be done in the next call of newDataAvailable().
+	inline virtual void flushRequested();
+
 };
 
 inline Stream::Stream() :
-	end_of_data(false)
+	end_of_data(false),
+	input_limit(0),
+	output_high(0),
+	output_low(0),
+	processing_paused(false)
 {
+#ifdef AGL_STREAM_STATS
+	Registry& reg = registry();
+	std::lock_guard< std::mutex > lock(reg.mutex);
+	reg.streams.insert(this);
+#endif
 }
 
 inline Stream::~Stream()
 {
+#ifdef AGL_STREAM_STATS
+	Registry& reg = registry();
+	std::lock_guard< std::mutex > lock(reg.mutex);
+	reg.streams.erase(this);
+#endif
 }
 
 inline void Stream::push(const Bytes& bytes)
 {
-	push((const char*)&bytes[0], bytes.size());
+	push((const char*)bytes.data(), bytes.size());
 }
 
 inline void Stream::push(const std::string& str)
@@ -86,11 +253,50 @@ inline void Stream::push(const std::string& str)
 
 inline void Stream::push(const char* bytes, uint64_t size)
 {
-	if (end_of_data) throw StreamInputClosed();
+	checkInputRoom(size);
 
 	input.insert((uint8_t*)bytes, (uint8_t*)bytes + size);
+	counters.addInput(size);
+
+	process();
+}
+
+inline void Stream::push(const struct iovec* iov, size_t iovcnt)
+{
+	size_t total_size = 0;
+	for (size_t iov_i = 0; iov_i < iovcnt; ++ iov_i) {
+		total_size += iov[iov_i].iov_len;
+	}
+	checkInputRoom(total_size);
+
+	input.reserve(input.size() + total_size);
+	for (size_t iov_i = 0; iov_i < iovcnt; ++ iov_i) {
+		uint8_t const* begin = (uint8_t const*)iov[iov_i].iov_base;
+		input.insert(begin, begin + iov[iov_i].iov_len);
+	}
+	counters.addInput(total_size);
+
+	process();
+}
+
+inline void Stream::push(Bytes&& bytes)
+{
+	checkInputRoom(bytes.size());
+
+	counters.addInput(bytes.size());
+	input.append(std::move(bytes));
+
+	process();
+}
+
+inline void Stream::push(ChunkBuf& chunks)
+{
+	checkInputRoom(chunks.size());
 
-	newDataAvailable(input.size(), false);
+	counters.addInput(chunks.size());
+	input.append(chunks);
+
+	process();
 }
 
 inline void Stream::setEndOfData()
@@ -98,7 +304,25 @@ inline void Stream::setEndOfData()
 	if (end_of_data) throw StreamInputClosed();
 	end_of_data = true;
 
-	newDataAvailable(input.size(), true);
+	process();
+}
+
+inline void Stream::flush()
+{
+	if (end_of_data) return;
+
+	flushRequested();
+	process();
+}
+
+inline void Stream::reset()
+{
+	input.clear();
+	output.clear();
+	end_of_data = false;
+	processing_paused = false;
+
+	resetRequested();
 }
 
 inline Bytes Stream::readBytes(size_t limit)
@@ -107,8 +331,15 @@ inline Bytes Stream::readBytes(size_t limit)
 	if (limit == 0 || limit > output.size()) amount_to_copy = output.size();
 	else amount_to_copy = limit;
 
-	Bytes result(amount_to_copy, 0);
-	output.read(&result[0], amount_to_copy);
+	Bytes result;
+	result.reserve(amount_to_copy);
+	while (result.size() < amount_to_copy) {
+		StreamBuffer::Region region = output.readableRegion();
+		if (region.size > amount_to_copy - result.size()) region.size = amount_to_copy - result.size();
+		result.insert(result.end(), region.begin, region.begin + region.size);
+		output.consume(region.size);
+	}
+	resumeProcessing();
 	return result;
 }
 
@@ -118,26 +349,314 @@ inline std::string Stream::readString(size_t limit)
 	if (limit == 0 || limit > output.size()) amount_to_copy = output.size();
 	else amount_to_copy = limit;
 
-	std::string result(amount_to_copy, ' ');
-	output.read((uint8_t*)&result[0], amount_to_copy);
+	std::string result;
+	result.reserve(amount_to_copy);
+	while (result.size() < amount_to_copy) {
+		StreamBuffer::Region region = output.readableRegion();
+		if (region.size > amount_to_copy - result.size()) region.size = amount_to_copy - result.size();
+		result.append((char const*)region.begin, region.size);
+		output.consume(region.size);
+	}
+	resumeProcessing();
+	return result;
+}
+
+inline size_t Stream::readInto(uint8_t* result, size_t capacity)
+{
+	struct iovec iov;
+	iov.iov_base = result;
+	iov.iov_len = capacity;
+	return readInto(&iov, 1);
+}
+
+inline size_t Stream::readInto(const struct iovec* iov, size_t iovcnt)
+{
+	size_t total_read = 0;
+	for (size_t iov_i = 0; iov_i < iovcnt && !output.empty(); ++ iov_i) {
+		total_read += copyOutput((uint8_t*)iov[iov_i].iov_base, iov[iov_i].iov_len);
+	}
+	resumeProcessing();
+	return total_read;
+}
+
+inline ChunkBuf Stream::readChunks(size_t limit)
+{
+	size_t amount;
+	if (limit == 0 || limit > output.size()) amount = output.size();
+	else amount = limit;
+
+	ChunkBuf result;
+	output.moveTo(result, amount);
+	resumeProcessing();
+	return result;
+}
+
+#ifndef _WIN32
+inline size_t Stream::writeTo(int fd)
+{
+	size_t const MAX_REGIONS = 16;
+	StreamBuffer::Region regions_buf[MAX_REGIONS];
+	size_t regions = output.readableRegions(regions_buf, MAX_REGIONS);
+	if (regions == 0) return 0;
+
+	struct iovec iov[MAX_REGIONS];
+	for (size_t region_i = 0; region_i < regions; ++ region_i) {
+		iov[region_i].iov_base = regions_buf[region_i].begin;
+		iov[region_i].iov_len = regions_buf[region_i].size;
+	}
+
+	ssize_t written;
+	do {
+		written = writev(fd, iov, regions);
+	} while (written < 0 && errno == EINTR);
+	if (written < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+		throw std::runtime_error("Unable to write to file descriptor: " + std::string(strerror(errno)));
+	}
+
+	output.consume(written);
+	resumeProcessing();
+	return written;
+}
+#endif
+
+inline bool Stream::pipeTo(Stream& target)
+{
+	size_t amount = output.size();
+	if (target.input_limit > 0) {
+		size_t room = target.input_limit > target.input.size() ? target.input_limit - target.input.size() : 0;
+		if (amount > room) amount = room;
+	}
+
+	if (amount > 0) {
+		if (target.end_of_data) throw StreamInputClosed();
+
+		target.input.moveFrom(output, amount);
+		target.counters.addInput(amount);
+
+		target.process();
+		resumeProcessing();
+	}
+
+	if (end_of_data && !processing_paused && output.empty() && !target.end_of_data) {
+		target.setEndOfData();
+		return true;
+	}
+	return amount > 0;
+}
+
+inline void Stream::setOutputLimits(size_t high, size_t low)
+{
+	if (low > high) throw std::runtime_error("Low limit of output must not be bigger than high limit!");
+	output_high = high;
+	output_low = low;
+	resumeProcessing();
+}
+
+inline void Stream::setInputLimit(size_t limit)
+{
+	input_limit = limit;
+}
+
+inline bool Stream::isOutputFull() const
+{
+	return processing_paused;
+}
+
+inline size_t Stream::outputSize() const
+{
+	return output.size();
+}
+
+inline void Stream::setChunkedStorage(size_t block_size)
+{
+	input.setChunked(block_size);
+	output.setChunked(block_size);
+}
+
+inline void Stream::setMirroredStorage()
+{
+	input.setMirrored();
+	output.setMirrored();
+}
+
+inline void Stream::setCapacityPolicy(size_t min_capacity, size_t growth_factor, size_t shrink_factor)
+{
+	input.setCapacityPolicy(min_capacity, growth_factor, shrink_factor);
+	output.setCapacityPolicy(min_capacity, growth_factor, shrink_factor);
+}
+
+inline void Stream::shrinkToFit()
+{
+	input.shrinkToFit();
+	output.shrinkToFit();
+}
+
+inline size_t Stream::capacity() const
+{
+	return input.capacity() + output.capacity();
+}
+
+inline size_t Stream::highWatermark() const
+{
+	return input.highWatermark() + output.highWatermark();
+}
+
+inline StreamStats Stream::stats() const
+{
+	StreamStats result;
+	counters.get(result);
+	result.streams = 1;
+	result.input_high_watermark = input.highWatermark();
+	result.output_high_watermark = output.highWatermark();
+	result.allocations = input.allocations() + output.allocations();
+	return result;
+}
+
+inline void Stream::resetStats()
+{
+	counters.reset();
+}
+
+inline StreamStats Stream::aggregateStats()
+{
+	StreamStats result;
+#ifdef AGL_STREAM_STATS
+	Registry& reg = registry();
+	std::lock_guard< std::mutex > lock(reg.mutex);
+	for (std::set< Stream const* >::const_iterator it = reg.streams.begin(); it != reg.streams.end(); ++ it) {
+		// Other Streams might be running in other
+		// threads, so only atomic counters are read.
+		StreamStats stream_stats;
+		(*it)->counters.get(stream_stats);
+		stream_stats.streams = 1;
+		result += stream_stats;
+	}
+#endif
 	return result;
 }
 
+#ifdef AGL_STREAM_STATS
+inline Stream::Registry& Stream::registry()
+{
+	static Registry reg;
+	return reg;
+}
+#endif
+
 inline void Stream::readInputData(Bytes& result, size_t limit)
 {
 	size_t amount_to_copy;
 	if (limit == 0 || limit > input.size()) amount_to_copy = input.size();
 	else amount_to_copy = limit;
 
-	uint8_t* readbuf = new uint8_t[amount_to_copy];
-	input.read(readbuf, amount_to_copy);
-	result.insert(result.end(), readbuf, readbuf + amount_to_copy);
-	delete[] readbuf;
+	result.reserve(result.size() + amount_to_copy);
+	while (amount_to_copy > 0) {
+		StreamBuffer::Region region = input.readableRegion();
+		if (region.size > amount_to_copy) region.size = amount_to_copy;
+		result.insert(result.end(), region.begin, region.begin + region.size);
+		input.consume(region.size);
+		amount_to_copy -= region.size;
+	}
 }
 
 inline void Stream::writeOutputData(uint8_t* begin, uint8_t* end)
 {
 	output.insert(begin, end);
+	counters.addOutput(end - begin);
+}
+
+inline void Stream::checkInputRoom(size_t size) const
+{
+	if (end_of_data) throw StreamInputClosed();
+	if (input_limit > 0 && input.size() + size > input_limit) throw StreamInputFull();
+}
+
+inline size_t Stream::copyOutput(uint8_t* result, size_t amount)
+{
+	size_t copied = 0;
+	while (copied < amount && !output.empty()) {
+		StreamBuffer::Region region = output.readableRegion();
+		if (region.size > amount - copied) region.size = amount - copied;
+		memcpy(result + copied, region.begin, region.size);
+		output.consume(region.size);
+		copied += region.size;
+	}
+	return copied;
+}
+
+inline bool Stream::outputFull() const
+{
+	return output_high > 0 && output.size() >= output_high;
+}
+
+inline void Stream::process()
+{
+	if (outputFull()) {
+		processing_paused = true;
+		return;
+	}
+#ifdef AGL_STREAM_STATS
+	std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+	newDataAvailable(input.size(), end_of_data);
+	counters.addProcessCall(std::chrono::duration_cast< std::chrono::nanoseconds >(std::chrono::steady_clock::now() - started).count());
+	counters.setBufferFigures(input.highWatermark(), output.highWatermark(), input.allocations() + output.allocations());
+#else
+	newDataAvailable(input.size(), end_of_data);
+#endif
+	processing_paused = outputFull();
+}
+
+inline void Stream::resumeProcessing()
+{
+	if (processing_paused && output.size() <= output_low) {
+		processing_paused = false;
+		process();
+	}
+}
+
+inline size_t Stream::viewInputData(uint8_t const*& begin) const
+{
+	StreamBuffer::Region region = input.readableRegion();
+	begin = region.begin;
+	return region.size;
+}
+
+inline void Stream::consumeInputData(size_t amount)
+{
+	input.consume(amount);
+}
+
+inline size_t Stream::inputDataSize() const
+{
+	return input.size();
+}
+
+inline size_t Stream::reserveOutputData(uint8_t*& begin, size_t min_size)
+{
+	StreamBuffer::Region region = output.writableRegion(min_size);
+	begin = region.begin;
+	// Do not let single write go much over the output limit
+	if (output_high > 0) {
+		size_t max_size = output.size() < output_high ? output_high - output.size() : 0;
+		if (max_size < min_size) max_size = min_size;
+		if (region.size > max_size) return max_size;
+	}
+	return region.size;
+}
+
+inline void Stream::commitOutputData(size_t amount)
+{
+	output.commit(amount);
+	counters.addOutput(amount);
+}
+
+inline void Stream::resetRequested()
+{
+}
+
+inline void Stream::flushRequested()
+{
 }
 
 }
@@ -0,0 +1,355 @@
+#ifndef AGL_STREAMBUFFER_HPP
+#define AGL_STREAMBUFFER_HPP
+
+#include "Bytes.hpp"
+#include "ChunkBuf.hpp"
+#include "MirroredRbuf.hpp"
+#include "Rbuf.hpp"
+
+#include <stdexcept>
+#include <utility>
+#include <stdint.h>
+
+namespace Agl
+{
+
+// Byte storage of Stream. Data is kept either in a ring buffer, which is
+// the default, in a mirrored ring buffer, or in a chain of reference
+// counted blocks. Reading and writing is done one contiguous region at
+// a time, so callers do not need to care which one is used.
+class StreamBuffer
+{
+
+public:
+
+	typedef ChunkBuf::Region Region;
+
+	inline StreamBuffer();
+
+	// Switches between ring buffer and chunk chain.
+	// Zero block size means ring buffer. Buffer must be empty.
+	inline void setChunked(size_t block_size);
+	inline bool isChunked() const;
+	// Switches to mirrored ring buffer, where all data and all free
+	// space are always one contiguous region. Buffer must be empty.
+	// Throws on platforms that do not support it.
+	inline void setMirrored();
+	inline bool isMirrored() const;
+
+	// Drops all data, but keeps allocated memory
+	inline void clear();
+	inline bool empty() const;
+	inline size_t size() const;
+
+	inline void insert(uint8_t const* begin, uint8_t const* end);
+	// Takes ownership of "bytes". Data is copied only in ring buffer mode.
+	inline void append(Bytes&& bytes);
+	// Moves all data of "source" to the end of this buffer. Data
+	// is shared instead of copied, if chunk chain is used.
+	inline void append(ChunkBuf& source);
+	// Moves "amount" bytes from the start of "source" to the end of this
+	// buffer. Data is shared instead of copied, if both use chunk chains.
+	inline void moveFrom(StreamBuffer& source, size_t amount);
+	// Moves "amount" bytes from the start of this buffer to "result"
+	inline void moveTo(ChunkBuf& result, size_t amount);
+
+	// Gets the first contiguous region of readable bytes
+	inline Region readableRegion() const;
+	// Gets at most "max_regions" contiguous regions of readable
+	// bytes, in reading order. Returns the amount of regions.
+	inline size_t readableRegions(Region* regions, size_t max_regions) const;
+	inline void consume(size_t amount);
+
+	// Ensures there is space for at least "min_amount" more bytes, and
+	// gets the first contiguous region of it. Region might be smaller
+	// than "min_amount" in plain ring buffer mode, if free space wraps.
+	inline Region writableRegion(size_t min_amount);
+	inline void commit(size_t amount);
+
+	// Memory management. Capacity policy applies to plain ring buffer mode.
+	inline void reserve(size_t amount);
+	inline void setCapacityPolicy(size_t min_capacity, size_t growth_factor, size_t shrink_factor);
+	inline void shrinkToFit();
+	inline size_t capacity() const;
+	inline size_t highWatermark() const;
+	// Returns how many times memory has been allocated for data
+	inline size_t allocations() const;
+
+private:
+
+	Rbuf< uint8_t > ring;
+	MirroredRbuf< uint8_t > mirror;
+	ChunkBuf chunks;
+	bool chunked;
+	bool mirrored;
+	// Peak size of chunk chain or mirrored
+	// ring, which do not track it themselves
+	size_t high_watermark;
+
+	StreamBuffer(StreamBuffer const&);
+	StreamBuffer& operator=(StreamBuffer const&);
+
+	inline void updateHighWatermark();
+
+};
+
+inline StreamBuffer::StreamBuffer() :
+	chunked(false),
+	mirrored(false),
+	high_watermark(0)
+{
+}
+
+inline void StreamBuffer::setChunked(size_t block_size)
+{
+	if (!empty()) {
+		throw std::runtime_error("Unable to change storage of non-empty buffer!");
+	}
+	ring.clear();
+	mirror.clear();
+	chunks = ChunkBuf(block_size > 0 ? block_size : 1);
+	chunked = block_size > 0;
+	mirrored = false;
+}
+
+inline bool StreamBuffer::isChunked() const
+{
+	return chunked;
+}
+
+inline void StreamBuffer::setMirrored()
+{
+	if (!MirroredRbuf< uint8_t >::supported()) {
+		throw std::runtime_error("Mirrored storage is supported only on Linux!");
+	}
+	if (!empty()) {
+		throw std::runtime_error("Unable to change storage of non-empty buffer!");
+	}
+	ring.clear();
+	chunks = ChunkBuf(1);
+	chunked = false;
+	mirrored = true;
+}
+
+inline bool StreamBuffer::isMirrored() const
+{
+	return mirrored;
+}
+
+inline void StreamBuffer::clear()
+{
+	consume(size());
+}
+
+inline bool StreamBuffer::empty() const
+{
+	return size() == 0;
+}
+
+inline size_t StreamBuffer::size() const
+{
+	if (chunked) return chunks.size();
+	if (mirrored) return mirror.size();
+	return ring.size();
+}
+
+inline void StreamBuffer::insert(uint8_t const* begin, uint8_t const* end)
+{
+	if (chunked) {
+		chunks.insert(begin, end);
+		updateHighWatermark();
+	} else if (mirrored) {
+		mirror.insert(begin, end);
+		updateHighWatermark();
+	} else {
+		ring.insert(begin, end);
+	}
+}
+
+inline void StreamBuffer::append(Bytes&& bytes)
+{
+	if (chunked) {
+		chunks.append(std::move(bytes));
+		updateHighWatermark();
+	} else {
+		insert(bytes.data(), bytes.data() + bytes.size());
+	}
+}
+
+inline void StreamBuffer::append(ChunkBuf& source)
+{
+	if (chunked) {
+		source.slice(chunks, source.size());
+		updateHighWatermark();
+		return;
+	}
+	Region region;
+	while (source.readableRegions(&region, 1) > 0) {
+		insert(region.begin, region.begin + region.size);
+		source.consume(region.size);
+	}
+}
+
+inline void StreamBuffer::moveFrom(StreamBuffer& source, size_t amount)
+{
+	if (amount > source.size()) {
+		throw std::runtime_error("Trying to move too much!");
+	}
+	if (chunked && source.chunked) {
+		source.chunks.slice(chunks, amount);
+		updateHighWatermark();
+		return;
+	}
+	while (amount > 0) {
+		Region region = source.readableRegion();
+		if (region.size > amount) region.size = amount;
+		insert(region.begin, region.begin + region.size);
+		source.consume(region.size);
+		amount -= region.size;
+	}
+}
+
+inline void StreamBuffer::moveTo(ChunkBuf& result, size_t amount)
+{
+	if (amount > size()) {
+		throw std::runtime_error("Trying to move too much!");
+	}
+	if (chunked) {
+		chunks.slice(result, amount);
+		return;
+	}
+	while (amount > 0) {
+		Region region = readableRegion();
+		if (region.size > amount) region.size = amount;
+		result.insert(region.begin, region.begin + region.size);
+		consume(region.size);
+		amount -= region.size;
+	}
+}
+
+inline StreamBuffer::Region StreamBuffer::readableRegion() const
+{
+	Region result;
+	if (readableRegions(&result, 1) == 0) {
+		result.begin = NULL;
+		result.size = 0;
+	}
+	return result;
+}
+
+inline size_t StreamBuffer::readableRegions(Region* regions, size_t max_regions) const
+{
+	if (chunked) {
+		return chunks.readableRegions(regions, max_regions);
+	}
+	if (mirrored) {
+		if (mirror.empty() || max_regions == 0) return 0;
+		MirroredRbuf< uint8_t >::Region region = mirror.readableRegion();
+		regions[0].begin = region.begin;
+		regions[0].size = region.size;
+		return 1;
+	}
+	Rbuf< uint8_t >::Region first, second;
+	size_t count = ring.readableRegions(first, second);
+	if (count > max_regions) count = max_regions;
+	if (count > 0) {
+		regions[0].begin = first.begin;
+		regions[0].size = first.size;
+	}
+	if (count > 1) {
+		regions[1].begin = second.begin;
+		regions[1].size = second.size;
+	}
+	return count;
+}
+
+inline void StreamBuffer::consume(size_t amount)
+{
+	if (chunked) {
+		chunks.consume(amount);
+	} else if (mirrored) {
+		mirror.consume(amount);
+	} else {
+		ring.consume(amount);
+	}
+}
+
+inline StreamBuffer::Region StreamBuffer::writableRegion(size_t min_amount)
+{
+	Region result;
+	if (chunked) {
+		result = chunks.writableRegion(min_amount > 0 ? min_amount : 1);
+	} else if (mirrored) {
+		MirroredRbuf< uint8_t >::Region region = mirror.writableRegion(min_amount);
+		result.begin = region.begin;
+		result.size = region.size;
+	} else {
+		Rbuf< uint8_t >::Region first, second;
+		ring.writableRegions(first, second, min_amount);
+		result.begin = first.begin;
+		result.size = first.size;
+	}
+	return result;
+}
+
+inline void StreamBuffer::commit(size_t amount)
+{
+	if (chunked) {
+		chunks.commit(amount);
+		updateHighWatermark();
+	} else if (mirrored) {
+		mirror.commit(amount);
+		updateHighWatermark();
+	} else {
+		ring.commit(amount);
+	}
+}
+
+inline void StreamBuffer::reserve(size_t amount)
+{
+	if (mirrored) {
+		mirror.reserve(amount);
+	} else if (!chunked) {
+		ring.reserve(amount);
+	}
+}
+
+inline void StreamBuffer::setCapacityPolicy(size_t min_capacity, size_t growth_factor, size_t shrink_factor)
+{
+	ring.setCapacityPolicy(min_capacity, growth_factor, shrink_factor);
+}
+
+inline void StreamBuffer::shrinkToFit()
+{
+	if (!chunked && !mirrored) {
+		ring.shrinkToFit();
+	}
+}
+
+inline size_t StreamBuffer::capacity() const
+{
+	if (chunked) return chunks.capacity();
+	if (mirrored) return mirror.capacity();
+	return ring.capacity();
+}
+
+inline size_t StreamBuffer::highWatermark() const
+{
+	return chunked || mirrored ? high_watermark : ring.highWatermark();
+}
+
+inline size_t StreamBuffer::allocations() const
+{
+	return ring.reallocations() + mirror.reallocations() + chunks.allocations();
+}
+
+inline void StreamBuffer::updateHighWatermark()
+{
+	if (size() > high_watermark) {
+		high_watermark = size();
+	}
+}
+
+}
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef AGL_STREAMIO_HPP
+#define AGL_STREAMIO_HPP
+
+#include "Stream.hpp"
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <stdint.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Agl
+{
+
+// Read only memory mapping of a whole file
+class MappedFile
+{
+
+public:
+
+	inline MappedFile(const std::string& path);
+	inline ~MappedFile();
+
+	inline uint8_t const* data() const;
+	inline size_t size() const;
+
+	// Tells that specific range is not needed anymore, so
+	// its pages can be dropped from memory right away.
+	inline void release(size_t offset, size_t size);
+
+private:
+
+	uint8_t* map;
+	size_t map_size;
+
+	MappedFile(MappedFile const&);
+	MappedFile& operator=(MappedFile const&);
+
+};
+
+// Pushes whole file through "stream" and writes the processed data to
+// "out_fd". Input is memory mapped, and it is pushed in chunks of given
+// size. Output is drained after every chunk, so memory usage is bounded
+// by the chunk size, no matter how big the file is.
+inline void streamFile(Stream& stream, const std::string& path, int out_fd, size_t chunk_size = 1024 * 1024);
+
+// Same as above, but reads input from file descriptor until end of file.
+inline void streamFd(Stream& stream, int in_fd, int out_fd, size_t chunk_size = 1024 * 1024);
+
+// Writes everything that "stream" has processed so far to "fd".
+inline void drainTo(Stream& stream, int fd);
+
+inline MappedFile::MappedFile(const std::string& path) :
+	map(NULL),
+	map_size(0)
+{
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		throw std::runtime_error("Unable to open " + path + ": " + std::string(strerror(errno)));
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		int error = errno;
+		close(fd);
+		throw std::runtime_error("Unable to stat " + path + ": " + std::string(strerror(error)));
+	}
+	map_size = st.st_size;
+	// Empty files can not be mapped
+	if (map_size > 0) {
+		void* ptr = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr == MAP_FAILED) {
+			int error = errno;
+			close(fd);
+			throw std::runtime_error("Unable to map " + path + ": " + std::string(strerror(error)));
+		}
+		map = (uint8_t*)ptr;
+		madvise(map, map_size, MADV_SEQUENTIAL);
+	}
+	close(fd);
+}
+
+inline MappedFile::~MappedFile()
+{
+	if (map_size > 0) {
+		munmap(map, map_size);
+	}
+}
+
+inline uint8_t const* MappedFile::data() const
+{
+	return map;
+}
+
+inline size_t MappedFile::size() const
+{
+	return map_size;
+}
+
+inline void MappedFile::release(size_t offset, size_t size)
+{
+	// Range must start from page boundary
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t begin = offset / page_size * page_size;
+	size_t end = offset + size;
+	if (end > map_size) end = map_size;
+	if (end > begin) {
+		madvise(map + begin, end - begin, MADV_DONTNEED);
+	}
+}
+
+inline void streamFile(Stream& stream, const std::string& path, int out_fd, size_t chunk_size)
+{
+	MappedFile file(path);
+	size_t offset = 0;
+	while (offset < file.size()) {
+		size_t amount = file.size() - offset;
+		if (amount > chunk_size) amount = chunk_size;
+		stream.push((char const*)file.data() + offset, amount);
+		drainTo(stream, out_fd);
+		file.release(offset, amount);
+		offset += amount;
+	}
+	stream.setEndOfData();
+	drainTo(stream, out_fd);
+}
+
+inline void streamFd(Stream& stream, int in_fd, int out_fd, size_t chunk_size)
+{
+	std::vector< uint8_t > chunk(chunk_size);
+	while (true) {
+		ssize_t readed = read(in_fd, chunk.data(), chunk.size());
+		if (readed < 0) {
+			if (errno == EINTR) continue;
+			throw std::runtime_error("Unable to read from file descriptor: " + std::string(strerror(errno)));
+		}
+		if (readed == 0) {
+			break;
+		}
+		stream.push((char const*)chunk.data(), readed);
+		drainTo(stream, out_fd);
+	}
+	stream.setEndOfData();
+	drainTo(stream, out_fd);
+}
+
+inline void drainTo(Stream& stream, int fd)
+{
+	// Writing might resume paused processing, so loop until all is done
+	while (stream.outputSize() > 0 || stream.isOutputFull()) {
+		if (stream.writeTo(fd) == 0) {
+			throw std::runtime_error("Unable to write to file descriptor, because it is full!");
+		}
+	}
+}
+
+}
+
+#endif
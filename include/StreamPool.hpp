@@ -0,0 +1,173 @@
+#ifndef AGL_STREAMPOOL_HPP
+#define AGL_STREAMPOOL_HPP
+
+#include "Stream.hpp"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Agl
+{
+
+// Keeps finished Streams for reuse, so that Streams which are expensive
+// to create, like compressors, are not created and destroyed for every
+// use. Streams are reset when they are returned. Thread safe.
+template< typename T >
+class StreamPool
+{
+
+public:
+
+	typedef std::function< T* () > Factory;
+
+	// Returns Stream to its pool, instead of deleting it
+	class Releaser
+	{
+	public:
+		inline Releaser(StreamPool< T >* pool = NULL);
+		inline void operator()(T* stream) const;
+	private:
+		StreamPool< T >* pool;
+	};
+
+	typedef std::unique_ptr< T, Releaser > Pointer;
+
+	// At most "max_idle" Streams are kept for reuse. First constructor
+	// creates Streams with their default constructor, and second one
+	// with given function, which must return a Stream created with new.
+	inline StreamPool(size_t max_idle = 16);
+	inline StreamPool(Factory const& factory, size_t max_idle = 16);
+	inline ~StreamPool();
+
+	// Gets a Stream from the pool, or creates a new one. Pool must
+	// exist longer than the returned pointer.
+	inline Pointer acquire();
+
+	// Returns amount of Streams that are waiting for reuse
+	inline size_t idleCount() const;
+	// Deletes Streams that are waiting for reuse
+	inline void clear();
+
+private:
+
+	typedef std::vector< T* > Streams;
+
+	mutable std::mutex mutex;
+	Streams idle;
+	size_t max_idle;
+	Factory factory;
+
+	StreamPool(StreamPool< T > const&);
+	StreamPool< T >& operator=(StreamPool< T > const&);
+
+	inline void release(T* stream);
+
+	static inline T* create();
+
+};
+
+template< typename T >
+inline StreamPool< T >::Releaser::Releaser(StreamPool< T >* pool) :
+	pool(pool)
+{
+}
+
+template< typename T >
+inline void StreamPool< T >::Releaser::operator()(T* stream) const
+{
+	if (pool) {
+		pool->release(stream);
+	} else {
+		delete stream;
+	}
+}
+
+template< typename T >
+inline StreamPool< T >::StreamPool(size_t max_idle) :
+	max_idle(max_idle),
+	factory(&StreamPool< T >::create)
+{
+}
+
+template< typename T >
+inline StreamPool< T >::StreamPool(Factory const& factory, size_t max_idle) :
+	max_idle(max_idle),
+	factory(factory)
+{
+}
+
+template< typename T >
+inline StreamPool< T >::~StreamPool()
+{
+	clear();
+}
+
+template< typename T >
+inline typename StreamPool< T >::Pointer StreamPool< T >::acquire()
+{
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		if (!idle.empty()) {
+			T* stream = idle.back();
+			idle.pop_back();
+			return Pointer(stream, Releaser(this));
+		}
+	}
+	return Pointer(factory(), Releaser(this));
+}
+
+template< typename T >
+inline size_t StreamPool< T >::idleCount() const
+{
+	std::lock_guard< std::mutex > lock(mutex);
+	return idle.size();
+}
+
+template< typename T >
+inline void StreamPool< T >::clear()
+{
+	Streams streams;
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		streams.swap(idle);
+	}
+	for (typename Streams::iterator it = streams.begin(); it != streams.end(); ++ it) {
+		delete *it;
+	}
+}
+
+template< typename T >
+inline void StreamPool< T >::release(T* stream)
+{
+	if (!stream) {
+		return;
+	}
+	// Reset outside the lock, because it might take a while
+	try {
+		stream->reset();
+	}
+	catch (...) {
+		delete stream;
+		return;
+	}
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		if (idle.size() < max_idle) {
+			idle.push_back(stream);
+			return;
+		}
+	}
+	delete stream;
+}
+
+template< typename T >
+inline T* StreamPool< T >::create()
+{
+	return new T();
+}
+
+}
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef AGL_STREAMSTATS_HPP
+#define AGL_STREAMSTATS_HPP
+
+#include <atomic>
+#include <stdint.h>
+
+namespace Agl
+{
+
+// Usage figures of a Stream, or a sum of several Streams. Byte and call
+// counters are collected only if AGL_STREAM_STATS is defined, otherwise
+// they stay zero. Buffer figures are always available. AGL_STREAM_STATS
+// must be defined the same way for libagl libraries and their users.
+struct StreamStats
+{
+	// Whether counters are collected in this build
+#ifdef AGL_STREAM_STATS
+	static bool const ENABLED = true;
+#else
+	static bool const ENABLED = false;
+#endif
+
+	// Amount of streams these figures are collected from
+	uint64_t streams;
+
+	uint64_t bytes_in;
+	uint64_t bytes_out;
+	// Calls of newDataAvailable, and time spent in them
+	uint64_t process_calls;
+	uint64_t process_nanoseconds;
+
+	// Maximum amount of buffered data. When summing, the biggest is kept.
+	uint64_t input_high_watermark;
+	uint64_t output_high_watermark;
+	// How many times buffers have allocated memory
+	uint64_t allocations;
+
+	inline StreamStats();
+
+	inline StreamStats& operator+=(StreamStats const& stats);
+
+	// Returns bytes_in divided by bytes_out. For compressing streams
+	// this is the compression ratio. Returns zero if there is no output.
+	inline double ratio() const;
+};
+
+// Counters that a Stream updates when it is running. They are atomic, so
+// that other threads can read them when aggregating. There is only one
+// writer, so updating does not need locked instructions.
+class StreamCounters
+{
+
+public:
+
+	inline StreamCounters();
+
+	inline void addInput(uint64_t amount);
+	inline void addOutput(uint64_t amount);
+	inline void addProcessCall(uint64_t nanoseconds);
+	// Copies buffer figures, so other threads can read them
+	inline void setBufferFigures(uint64_t input_high_watermark, uint64_t output_high_watermark, uint64_t allocations);
+
+	inline void reset();
+
+	// Writes counters to "stats"
+	inline void get(StreamStats& stats) const;
+
+private:
+
+	std::atomic< uint64_t > bytes_in;
+	std::atomic< uint64_t > bytes_out;
+	std::atomic< uint64_t > process_calls;
+	std::atomic< uint64_t > process_nanoseconds;
+	std::atomic< uint64_t > input_high_watermark;
+	std::atomic< uint64_t > output_high_watermark;
+	std::atomic< uint64_t > allocations;
+
+	static inline void add(std::atomic< uint64_t >& counter, uint64_t amount);
+
+};
+
+inline StreamStats::StreamStats() :
+	streams(0),
+	bytes_in(0),
+	bytes_out(0),
+	process_calls(0),
+	process_nanoseconds(0),
+	input_high_watermark(0),
+	output_high_watermark(0),
+	allocations(0)
+{
+}
+
+inline StreamStats& StreamStats::operator+=(StreamStats const& stats)
+{
+	streams += stats.streams;
+	bytes_in += stats.bytes_in;
+	bytes_out += stats.bytes_out;
+	process_calls += stats.process_calls;
+	process_nanoseconds += stats.process_nanoseconds;
+	if (stats.input_high_watermark > input_high_watermark) input_high_watermark = stats.input_high_watermark;
+	if (stats.output_high_watermark > output_high_watermark) output_high_watermark = stats.output_high_watermark;
+	allocations += stats.allocations;
+	return *this;
+}
+
+inline double StreamStats::ratio() const
+{
+	if (bytes_out == 0) return 0;
+	return double(bytes_in) / double(bytes_out);
+}
+
+inline StreamCounters::StreamCounters() :
+	bytes_in(0),
+	bytes_out(0),
+	process_calls(0),
+	process_nanoseconds(0),
+	input_high_watermark(0),
+	output_high_watermark(0),
+	allocations(0)
+{
+}
+
+inline void StreamCounters::addInput(uint64_t amount)
+{
+#ifdef AGL_STREAM_STATS
+	add(bytes_in, amount);
+#else
+	(void)amount;
+#endif
+}
+
+inline void StreamCounters::addOutput(uint64_t amount)
+{
+#ifdef AGL_STREAM_STATS
+	add(bytes_out, amount);
+#else
+	(void)amount;
+#endif
+}
+
+inline void StreamCounters::addProcessCall(uint64_t nanoseconds)
+{
+#ifdef AGL_STREAM_STATS
+	add(process_calls, 1);
+	add(process_nanoseconds, nanoseconds);
+#else
+	(void)nanoseconds;
+#endif
+}
+
+inline void StreamCounters::setBufferFigures(uint64_t input_high_watermark, uint64_t output_high_watermark, uint64_t allocations)
+{
+#ifdef AGL_STREAM_STATS
+	this->input_high_watermark.store(input_high_watermark, std::memory_order_relaxed);
+	this->output_high_watermark.store(output_high_watermark, std::memory_order_relaxed);
+	this->allocations.store(allocations, std::memory_order_relaxed);
+#else
+	(void)input_high_watermark;
+	(void)output_high_watermark;
+	(void)allocations;
+#endif
+}
+
+inline void StreamCounters::reset()
+{
+	bytes_in.store(0, std::memory_order_relaxed);
+	bytes_out.store(0, std::memory_order_relaxed);
+	process_calls.store(0, std::memory_order_relaxed);
+	process_nanoseconds.store(0, std::memory_order_relaxed);
+}
+
+inline void StreamCounters::get(StreamStats& stats) const
+{
+	stats.bytes_in = bytes_in.load(std::memory_order_relaxed);
+	stats.bytes_out = bytes_out.load(std::memory_order_relaxed);
+	stats.process_calls = process_calls.load(std::memory_order_relaxed);
+	stats.process_nanoseconds = process_nanoseconds.load(std::memory_order_relaxed);
+	stats.input_high_watermark = input_high_watermark.load(std::memory_order_relaxed);
+	stats.output_high_watermark = output_high_watermark.load(std::memory_order_relaxed);
+	stats.allocations = allocations.load(std::memory_order_relaxed);
+}
+
+inline void StreamCounters::add(std::atomic< uint64_t >& counter, uint64_t amount)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+}
+
+#endif
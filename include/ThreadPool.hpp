@@ -0,0 +1,257 @@
+#ifndef AGL_THREADPOOL_HPP
+#define AGL_THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+namespace Agl
+{
+
+// Runs many small tasks on all cores. Each worker starts with its own
+// share of the tasks, and when it runs out, it steals half of what is
+// left from another worker. Calling thread works too, so it is one of
+// the workers.
+class ThreadPool
+{
+
+public:
+
+	// Gets index of task, and index of worker that runs it
+	typedef std::function< void (size_t index, size_t worker) > Task;
+
+	// Zero "workers" means amount of hardware threads
+	inline explicit ThreadPool(size_t workers = 0);
+	inline ~ThreadPool();
+
+	inline size_t workerCount() const;
+
+	// Runs task for each index from zero to "count" - 1, and waits until
+	// all are done. Worker index is from zero to workerCount() - 1, so
+	// tasks can keep state per worker. If a task throws, the rest are
+	// skipped, and the exception is thrown here. One run at a time.
+	inline void run(size_t count, Task const& task);
+
+private:
+
+	// Tasks that are left for a worker
+	struct Range
+	{
+		std::mutex mutex;
+		size_t begin;
+		size_t end;
+	};
+
+	size_t worker_count;
+	std::unique_ptr< Range[] > ranges;
+	std::vector< std::thread > threads;
+
+	std::mutex run_mutex;
+
+	std::mutex mutex;
+	std::condition_variable work_cond;
+	std::condition_variable done_cond;
+	Task const* task;
+	uint64_t generation;
+	size_t busy_threads;
+	bool stopping;
+
+	std::exception_ptr error;
+	std::atomic< bool > failed;
+
+	ThreadPool(ThreadPool const&);
+	ThreadPool& operator=(ThreadPool const&);
+
+	inline void runThread(size_t worker);
+
+	// Runs tasks, until there is nothing left to steal
+	inline void work(size_t worker);
+
+	inline bool takeTask(size_t worker, size_t& index);
+
+};
+
+inline ThreadPool::ThreadPool(size_t workers) :
+	task(NULL),
+	generation(0),
+	busy_threads(0),
+	stopping(false),
+	failed(false)
+{
+	if (workers == 0) {
+		workers = std::thread::hardware_concurrency();
+		if (workers == 0) workers = 1;
+	}
+	worker_count = workers;
+	ranges.reset(new Range[worker_count]);
+	for (size_t worker = 0; worker < worker_count; ++ worker) {
+		ranges[worker].begin = 0;
+		ranges[worker].end = 0;
+	}
+
+	// Last worker is the calling thread
+	try {
+		for (size_t worker = 0; worker + 1 < worker_count; ++ worker) {
+			threads.push_back(std::thread(&ThreadPool::runThread, this, worker));
+		}
+	}
+	catch (...) {
+		{
+			std::lock_guard< std::mutex > lock(mutex);
+			stopping = true;
+		}
+		work_cond.notify_all();
+		for (size_t thread_i = 0; thread_i < threads.size(); ++ thread_i) {
+			threads[thread_i].join();
+		}
+		throw;
+	}
+}
+
+inline ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		stopping = true;
+	}
+	work_cond.notify_all();
+	for (size_t thread_i = 0; thread_i < threads.size(); ++ thread_i) {
+		threads[thread_i].join();
+	}
+}
+
+inline size_t ThreadPool::workerCount() const
+{
+	return worker_count;
+}
+
+inline void ThreadPool::run(size_t count, Task const& task)
+{
+	std::lock_guard< std::mutex > run_lock(run_mutex);
+
+	if (count == 0) {
+		return;
+	}
+
+	// Share tasks evenly. Threads do not touch
+	// ranges before they are woken up below.
+	for (size_t worker = 0; worker < worker_count; ++ worker) {
+		ranges[worker].begin = count * worker / worker_count;
+		ranges[worker].end = count * (worker + 1) / worker_count;
+	}
+
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		this->task = &task;
+		error = std::exception_ptr();
+		failed = false;
+		busy_threads = threads.size();
+		++ generation;
+	}
+	work_cond.notify_all();
+
+	work(worker_count - 1);
+
+	std::unique_lock< std::mutex > lock(mutex);
+	while (busy_threads > 0) {
+		done_cond.wait(lock);
+	}
+	this->task = NULL;
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+inline void ThreadPool::runThread(size_t worker)
+{
+	uint64_t done_generation = 0;
+	while (true) {
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			while (!stopping && generation == done_generation) {
+				work_cond.wait(lock);
+			}
+			if (stopping) {
+				return;
+			}
+			done_generation = generation;
+		}
+
+		work(worker);
+
+		std::lock_guard< std::mutex > lock(mutex);
+		-- busy_threads;
+		if (busy_threads == 0) {
+			done_cond.notify_all();
+		}
+	}
+}
+
+inline void ThreadPool::work(size_t worker)
+{
+	size_t index;
+	while (takeTask(worker, index)) {
+		// After failure, tasks are only taken away
+		if (failed.load(std::memory_order_relaxed)) {
+			continue;
+		}
+		try {
+			(*task)(index, worker);
+		}
+		catch (...) {
+			std::lock_guard< std::mutex > lock(mutex);
+			if (!error) {
+				error = std::current_exception();
+			}
+			failed = true;
+		}
+	}
+}
+
+inline bool ThreadPool::takeTask(size_t worker, size_t& index)
+{
+	Range& own = ranges[worker];
+	{
+		std::lock_guard< std::mutex > lock(own.mutex);
+		if (own.begin < own.end) {
+			index = own.begin ++;
+			return true;
+		}
+	}
+
+	// Steal the second half of tasks that another worker has left. Only
+	// one lock is held at a time, and stolen tasks are not in any range
+	// for a moment, but the thief always runs them.
+	for (size_t offset = 1; offset < worker_count; ++ offset) {
+		Range& victim = ranges[(worker + offset) % worker_count];
+		size_t begin;
+		size_t end;
+		{
+			std::lock_guard< std::mutex > lock(victim.mutex);
+			if (victim.begin >= victim.end) {
+				continue;
+			}
+			end = victim.end;
+			victim.end -= (victim.end - victim.begin + 1) / 2;
+			begin = victim.end;
+		}
+		{
+			std::lock_guard< std::mutex > lock(own.mutex);
+			own.begin = begin + 1;
+			own.end = end;
+		}
+		index = begin;
+		return true;
+	}
+	return false;
+}
+
+}
+
+#endif
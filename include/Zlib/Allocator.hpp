@@ -0,0 +1,33 @@
+#ifndef AGL_ZLIB_ALLOCATOR_HPP
+#define AGL_ZLIB_ALLOCATOR_HPP
+
+#include <cstddef>
+
+namespace Agl
+{
+
+namespace Zlib
+{
+
+// Memory allocator for the internal state of zlib. Codecs that are given
+// an allocator use it instead of malloc. The allocator must exist longer
+// than the codecs that use it.
+class Allocator
+{
+
+public:
+
+	inline virtual ~Allocator() { }
+
+	// Allocates memory for "items" items of "size" bytes.
+	// Returns NULL, if there is not enough memory.
+	virtual void* allocate(size_t items, size_t size) = 0;
+	virtual void deallocate(void* ptr) = 0;
+
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef AGL_ZLIB_ARENAALLOCATOR_HPP
+#define AGL_ZLIB_ARENAALLOCATOR_HPP
+
+#include "Allocator.hpp"
+
+#include <vector>
+#include <stdint.h>
+
+namespace Agl
+{
+
+namespace Zlib
+{
+
+// Allocator that hands out memory from big blocks, by just moving a
+// pointer forward. Deallocation does nothing. All memory is released at
+// once with reset(), so it suits codecs that live for a single request.
+// Not thread safe, so use one arena per thread or request.
+class ArenaAllocator : public Allocator
+{
+
+public:
+
+	// Default block size fits one Deflator with default settings
+	ArenaAllocator(size_t block_size = 512 * 1024);
+	virtual ~ArenaAllocator();
+
+	virtual void* allocate(size_t items, size_t size);
+	virtual void deallocate(void* ptr);
+
+	// Makes all memory available again. Memory of the first block is kept
+	// for reuse, and the rest is freed. Codecs using the arena must have
+	// been destroyed before this.
+	void reset();
+
+	// Amount of memory handed out since construction or reset
+	size_t used() const;
+	// Amount of memory held in blocks
+	size_t reserved() const;
+
+private:
+
+	struct Block
+	{
+		uint8_t* data;
+		size_t size;
+	};
+	typedef std::vector< Block > Blocks;
+
+	size_t block_size;
+	Blocks blocks;
+	// Position in the last block
+	size_t block_pos;
+	size_t total_used;
+
+	ArenaAllocator(ArenaAllocator const&);
+	ArenaAllocator& operator=(ArenaAllocator const&);
+
+};
+
+}
+
+}
+
+#endif
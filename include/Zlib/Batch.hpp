@@ -0,0 +1,44 @@
+#ifndef AGL_ZLIB_BATCH_HPP
+#define AGL_ZLIB_BATCH_HPP
+
+#include "../Bytes.hpp"
+#include "../ThreadPool.hpp"
+#include "Deflator.hpp"
+
+#include <vector>
+
+namespace Agl
+{
+
+namespace Zlib
+{
+
+// Compresses or decompresses many independent buffers at once, using
+// all cores. Each thread reuses its zlib state and output buffer, so
+// memory is allocated only for the results. Formats are the same as
+// with compress() and decompress(). One batch at a time.
+class Batch
+{
+
+public:
+
+	// Zero "threads" means amount of hardware threads
+	Batch(size_t threads = 0);
+
+	std::vector< Bytes > compress(std::vector< Bytes > const& inputs, Deflator::Level level = Deflator::DEFAULT_COMPRESSION);
+	std::vector< Bytes > decompress(std::vector< Bytes > const& inputs);
+
+private:
+
+	ThreadPool pool;
+
+	// Output buffer of each worker
+	std::vector< Bytes > buffers;
+
+};
+
+}
+
+}
+
+#endif
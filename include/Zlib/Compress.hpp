@@ -0,0 +1,45 @@
+#ifndef AGL_ZLIB_COMPRESS_HPP
+#define AGL_ZLIB_COMPRESS_HPP
+
+#include "../Bytes.hpp"
+#include "Deflator.hpp"
+
+#include <stdint.h>
+
+namespace Agl
+{
+
+namespace Zlib
+{
+
+// One-shot compression of data that is fully in memory. Output is written
+// directly to a single buffer, and each thread reuses its zlib state,
+// so this is much faster than Deflator for small data. Output is the
+// same zlib format that Deflator writes.
+
+// Returns the maximum size of compressed data, for "size" bytes of input
+size_t maxCompressedSize(size_t size);
+
+Bytes compress(uint8_t const* data, size_t size, Deflator::Level level = Deflator::DEFAULT_COMPRESSION);
+Bytes compress(Bytes const& data, Deflator::Level level = Deflator::DEFAULT_COMPRESSION);
+// Compresses to buffer of caller. Returns size of compressed data.
+// Throws, if it does not fit. Capacity of maxCompressedSize() always fits.
+size_t compressInto(uint8_t const* data, size_t size, uint8_t* result, size_t capacity, Deflator::Level level = Deflator::DEFAULT_COMPRESSION);
+
+// Decompresses zlib or gzip data. If uncompressed size is known, it should
+// be given as "size_hint", so the result is allocated only once.
+Bytes decompress(uint8_t const* data, size_t size, size_t size_hint = 0);
+Bytes decompress(Bytes const& data, size_t size_hint = 0);
+// Decompresses to buffer of caller. Returns size of decompressed data.
+// Throws, if it does not fit.
+size_t decompressInto(uint8_t const* data, size_t size, uint8_t* result, size_t capacity);
+// Decompresses to the beginning of "buffer", and grows it if needed.
+// Returns size of decompressed data. Buffer can be reused, so that
+// memory is not allocated again for every call.
+size_t decompressInto(uint8_t const* data, size_t size, Bytes& buffer);
+
+}
+
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define AGL_ZLIB_DEFLATOR_HPP
 
 #include "../Stream.hpp"
+#include "Allocator.hpp"
 
 namespace Agl
 {
@@ -21,14 +22,112 @@ public:
 		BEST
 	};
 
-	Deflator(Level level = DEFAULT_COMPRESSION);
+	// Partial flush adds the least bytes. Full flush also resets the
+	// history, so decompressing can be recovered after lost data.
+	enum FlushMode {
+		NO_FLUSH,
+		PARTIAL_FLUSH,
+		SYNC_FLUSH,
+		FULL_FLUSH
+	};
+
+	// Filtered suits data with small random variation, Huffman only and
+	// RLE are fast, and fixed disables dynamic Huffman codes.
+	enum Strategy {
+		DEFAULT_STRATEGY,
+		FILTERED,
+		HUFFMAN_ONLY,
+		RLE,
+		FIXED
+	};
+
+	// All parameters of zlib
+	struct Options
+	{
+		// From 0 to 9, or -1 for the default of zlib
+		int level;
+		// Window is 2^window_bits bytes. From 9 to 15.
+		int window_bits;
+		// Memory used for compression state. From 1 to 9.
+		int mem_level;
+		Strategy strategy;
+
+		explicit Options(Level level = DEFAULT_COMPRESSION);
+	};
+
+	// If "allocator" is given, zlib state is allocated with it
+	Deflator(Level level = DEFAULT_COMPRESSION, Allocator* allocator = NULL);
+	Deflator(Options const& options, Allocator* allocator = NULL);
 	virtual ~Deflator();
 
+	// Returns uncompressed size divided by compressed size, of
+	// all data that has been processed so far. Zero if nothing.
+	double compressionRatio() const;
+
+	// Sets preset dictionary. Data that resembles the dictionary compresses
+	// better, which helps especially with small messages. Must be called
+	// before any data is pushed. Dictionary is kept over reset().
+	void setDictionary(Bytes const& dictionary);
+
+	// Makes every push end with a flush of given type, so that the
+	// receiver can decompress all pushed data right away. Explicit
+	// flush() uses this type too, or sync flush, if this is NO_FLUSH.
+	void setFlushMode(FlushMode mode);
+
+	// Changes level and strategy in the middle of stream. Data that
+	// has been pushed before is compressed with the old parameters.
+	void setParams(int level, Strategy strategy = DEFAULT_STRATEGY);
+	// Returns level that zlib currently uses. A level that has been set,
+	// or picked by adaptive mode, is applied when more data is compressed.
+	int level() const;
+
+	// Adaptive mode picks level from 1 to 9, based on measured time of
+	// compressing. Level is lowered if compressing is slower than
+	// "target_throughput" bytes per second, or if it takes more than
+	// "cpu_budget" share of the wall clock time. Level is raised, if
+	// there is plenty of room. Zero disables a limit, and with both
+	// zero, adaptive mode is off. Negative limits are invalid.
+	// Strategy is left as it is.
+	void setAdaptive(double target_throughput, double cpu_budget = 0);
+
 private:
 
 	void* zstrm;
 
+	Bytes dictionary;
+
+	FlushMode flush_mode;
+	// Flush that is requested, but not done yet. Z_NO_FLUSH if none.
+	int pending_flush;
+
+	// Parameters in use, and the ones that will be taken into use
+	// before compressing more data. All are zlib values.
+	int zlib_level;
+	int zlib_strategy;
+	int wanted_level;
+	int wanted_strategy;
+
+	double target_throughput;
+	double cpu_budget;
+	// Measurements of adaptive mode, since the level was last picked
+	uint64_t window_bytes;
+	uint64_t window_nanoseconds;
+	uint64_t window_started;
+
 	virtual void newDataAvailable(uint64_t amount, bool end_of_data);
+	virtual void resetRequested();
+	virtual void flushRequested();
+
+	// Compresses data from zstream input directly to output buffer.
+	// Returns false, if output got full before everything was done.
+	bool runDeflate(int flush);
+
+	// Takes wanted parameters into use. Returns false, if
+	// output got full before pending data was compressed.
+	bool applyParams();
+
+	// Picks level of adaptive mode, if enough has been measured
+	void adaptLevel(uint64_t bytes, uint64_t nanoseconds);
 
 };
 
@@ -0,0 +1,28 @@
+#ifndef AGL_ZLIB_DICTIONARY_HPP
+#define AGL_ZLIB_DICTIONARY_HPP
+
+#include "../Bytes.hpp"
+
+#include <vector>
+#include <stdint.h>
+
+namespace Agl
+{
+
+namespace Zlib
+{
+
+// Builds preset dictionary from sample messages. Picks the pieces of
+// samples that contain the most substrings which are common to many
+// samples. The most useful pieces are placed at the end, because
+// deflate encodes short distances more efficiently.
+Bytes buildDictionary(std::vector< Bytes > const& samples, size_t max_size = 32 * 1024);
+
+// Returns id of dictionary, that is stored in compressed data
+uint32_t dictionaryId(Bytes const& dictionary);
+
+}
+
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef AGL_ZLIB_INDEX_HPP
+#define AGL_ZLIB_INDEX_HPP
+
+#include "../Bytes.hpp"
+
+#include <vector>
+#include <stdint.h>
+
+namespace Agl
+{
+
+namespace Zlib
+{
+
+// Access points of compressed data, at which decompression can be started
+// without decompressing anything before it. Built by IndexingInflator and
+// used by SeekableReader. Can be serialized, so it needs to be built once.
+class Index
+{
+
+public:
+
+	struct AccessPoint
+	{
+		uint64_t uncompressed_offset;
+		// Offset of the first whole byte in compressed data
+		uint64_t compressed_offset;
+		// Amount of bits from the byte before "compressed_offset"
+		// that belong to data after this point. Zero to seven.
+		uint8_t bits;
+		// At most 32 KiB of uncompressed data before this point
+		Bytes window;
+	};
+
+	// Access points are created approximately
+	// every "spacing" bytes of uncompressed data.
+	Index(uint64_t spacing = 1024 * 1024);
+
+	uint64_t spacing() const;
+
+	size_t size() const;
+	bool empty() const;
+	AccessPoint const& operator[](size_t point_i) const;
+
+	// Returns the last access point at or before "uncompressed_offset"
+	AccessPoint const& find(uint64_t uncompressed_offset) const;
+
+	// Returns true, if whole compressed stream has been indexed
+	bool complete() const;
+	// Total size of uncompressed data. Known when index is complete.
+	uint64_t uncompressedSize() const;
+
+	void clear();
+	void addPoint(AccessPoint const& point);
+	void setComplete(uint64_t uncompressed_size);
+
+	Bytes serialize() const;
+	// Replaces contents with serialized index. Throws if data is invalid.
+	void deserialize(Bytes const& bytes);
+
+private:
+
+	typedef std::vector< AccessPoint > AccessPoints;
+
+	uint64_t point_spacing;
+	AccessPoints points;
+	bool is_complete;
+	uint64_t uncompressed_size;
+
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef AGL_ZLIB_INDEXINGINFLATOR_HPP
+#define AGL_ZLIB_INDEXINGINFLATOR_HPP
+
+#include "../Stream.hpp"
+#include "Index.hpp"
+
+namespace Agl
+{
+
+namespace Zlib
+{
+
+// Decompresses zlib or gzip data like Inflator, and records access
+// points to Index at the same time. The index is complete, when the
+// end of compressed stream has been decompressed.
+class IndexingInflator : public Stream
+{
+
+public:
+
+	// "index" is not owned. It is cleared first.
+	IndexingInflator(Index& index);
+	virtual ~IndexingInflator();
+
+private:
+
+	void* zstrm;
+
+	bool stream_end;
+
+	Index& index;
+	uint64_t last_point_offset;
+
+	// Last 32 KiB of decompressed data, as a ring
+	Bytes window;
+	size_t window_pos;
+
+	virtual void newDataAvailable(uint64_t amount, bool end_of_data);
+	virtual void resetRequested();
+
+	// Decompresses data from zstream input directly to output
+	// buffer. Stops at the end of each deflate block.
+	void runInflate();
+
+	void updateWindow(uint8_t const* begin, size_t size);
+	// Adds access point, if current position is suitable for it
+	void addPointIfNeeded();
+
+};
+
+}
+
+}
+
+#endif
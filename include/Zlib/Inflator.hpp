@@ -2,6 +2,7 @@
 #define AGL_ZLIB_INFLATOR_HPP
 
 #include "../Stream.hpp"
+#include "Allocator.hpp"
 
 namespace Agl
 {
@@ -14,14 +15,53 @@ class Inflator : public Stream
 
 public:
 
-	Inflator();
+	class OutputLimitExceeded : public std::runtime_error
+	{
+	public:
+		inline OutputLimitExceeded() : std::runtime_error("Decompressed data exceeds maximum size!") { }
+		inline virtual ~OutputLimitExceeded() throw () { }
+		inline virtual const char* what() const throw () { return "Decompressed data exceeds maximum size!"; }
+	};
+
+	// If "allocator" is given, zlib state is allocated with it
+	Inflator(Allocator* allocator = NULL);
 	virtual ~Inflator();
 
+	// Returns uncompressed size divided by compressed size, of
+	// all data that has been processed so far. Zero if nothing.
+	double compressionRatio() const;
+
+	// Sets dictionary that is used, if compressed data requires one. It
+	// must be the same that was used in compressing. Kept over reset().
+	void setDictionary(Bytes const& dictionary);
+
+	// Limits total size of decompressed data. If compressed data
+	// expands beyond this, OutputLimitExceeded is thrown. This
+	// protects from decompression bombs. Zero means no limit.
+	void setMaxOutputSize(size_t max_size);
+	// If decompressed size is known, giving it here lets output
+	// buffer be allocated once, instead of growing step by step.
+	// Both settings are kept over reset().
+	void setExpectedSize(size_t size);
+
 private:
 
 	void* zstrm;
 
+	Bytes dictionary;
+
+	size_t max_output_size;
+	size_t expected_size;
+	// Decompressed bytes since start or reset
+	size_t total_output;
+
+	bool stream_end;
+
 	virtual void newDataAvailable(uint64_t amount, bool end_of_data);
+	virtual void resetRequested();
+
+	// Decompresses data from zstream input directly to output buffer
+	void runInflate(int flush);
 
 };
 
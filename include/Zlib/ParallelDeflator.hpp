@@ -0,0 +1,89 @@
+#ifndef AGL_ZLIB_PARALLELDEFLATOR_HPP
+#define AGL_ZLIB_PARALLELDEFLATOR_HPP
+
+#include "../Stream.hpp"
+#include "Deflator.hpp"
+
+#include <deque>
+#include <memory>
+#include <stdint.h>
+
+namespace Agl
+{
+
+namespace Zlib
+{
+
+// Compresses data using multiple threads. Input is split to blocks, which
+// are compressed independently by worker threads. Each block uses the end
+// of the previous data as dictionary, so compression ratio stays close to
+// that of Deflator. Blocks are joined to one normal zlib or gzip stream.
+//
+// Compressed blocks are moved to output when data is pushed, and
+// everything is ready after setEndOfData() has returned. flush() gives
+// the rest of input as a short block and waits until all is written.
+class ParallelDeflator : public Stream
+{
+
+public:
+
+	enum Format {
+		ZLIB,
+		GZIP
+	};
+
+	// Zero "threads" means amount of hardware threads
+	ParallelDeflator(Deflator::Level level = Deflator::DEFAULT_COMPRESSION, Format format = ZLIB, size_t threads = 0, size_t block_size = 128 * 1024);
+	virtual ~ParallelDeflator();
+
+private:
+
+	struct Job;
+	struct Workers;
+
+	typedef std::deque< std::shared_ptr< Job > > Jobs;
+
+	int zlevel;
+	Format format;
+	size_t block_size;
+	size_t max_jobs;
+
+	Workers* workers;
+
+	// Jobs that have been given to workers, in the order of data
+	Jobs jobs;
+
+	bool header_written;
+	bool last_block_given;
+	bool trailer_written;
+	bool flush_pending;
+
+	// Adler-32 or CRC-32 of all data that has been compressed
+	uint32_t check;
+	uint64_t total_size;
+
+	// End of data so far, for priming the next block
+	Bytes dictionary;
+
+	virtual void newDataAvailable(uint64_t amount, bool end_of_data);
+	virtual void resetRequested();
+	virtual void flushRequested();
+
+	// Gives next block of input to workers
+	void giveBlock(bool last);
+	// Moves compressed blocks to output, in order. If "wait" is
+	// true, waits until at least the first block is ready.
+	void collectBlocks(bool wait);
+
+	void writeHeader();
+	void writeTrailer();
+
+	static void runWorker(Workers* workers, int zlevel, Format format);
+
+};
+
+}
+
+}
+
+#endif
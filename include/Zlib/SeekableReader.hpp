@@ -0,0 +1,64 @@
+#ifndef AGL_ZLIB_SEEKABLEREADER_HPP
+#define AGL_ZLIB_SEEKABLEREADER_HPP
+
+#include "Index.hpp"
+
+#include <stdint.h>
+
+namespace Agl
+{
+
+namespace Zlib
+{
+
+// Reads uncompressed data from any position of compressed file, using
+// an Index of it. Decompression starts from the nearest access point
+// before the position, so the cost of reading does not depend on the
+// size of the file. Consecutive reads continue where the previous one
+// ended, without going back to an access point.
+class SeekableReader
+{
+
+public:
+
+	// "fd" must be a seekable file, that begins with the compressed data
+	// "index" was built from. Neither "fd" nor "index" is owned.
+	SeekableReader(int fd, Index const& index);
+	~SeekableReader();
+
+	// Reads at most "amount" bytes of uncompressed data, starting from
+	// "offset". Returns amount that was read. It is less than "amount"
+	// only if end of data is reached.
+	size_t read(uint64_t offset, uint8_t* result, size_t amount);
+
+private:
+
+	int fd;
+	Index const& index;
+
+	void* zstrm;
+	bool active;
+	bool stream_end;
+	// Uncompressed and compressed position of zstream
+	uint64_t position;
+	uint64_t compressed_position;
+
+	Bytes input;
+
+	SeekableReader(SeekableReader const&);
+	SeekableReader& operator=(SeekableReader const&);
+
+	// Starts decompressing from the access point before "offset"
+	void startFrom(uint64_t offset);
+	// Decompresses to "result". Returns amount that was decompressed.
+	size_t inflateTo(uint8_t* result, size_t amount);
+	// Reads from file at "offset". Returns false at end of file.
+	bool readInput(uint64_t offset, uint8_t* result, size_t amount, size_t& result_size);
+
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef AGL_ZSTD_COMPRESSOR_HPP
+#define AGL_ZSTD_COMPRESSOR_HPP
+
+#include "../Stream.hpp"
+
+namespace Agl
+{
+
+namespace Zstd
+{
+
+// Compresses to Zstandard frame format, that the zstd tool can also
+// read. Usually both faster and better than deflate.
+class Compressor : public Stream
+{
+
+public:
+
+	enum Level {
+		FAST,
+		DEFAULT_COMPRESSION,
+		BEST
+	};
+
+	Compressor(Level level = DEFAULT_COMPRESSION);
+	virtual ~Compressor();
+
+private:
+
+	void* cctx;
+
+	bool frame_ended;
+	bool pending_flush;
+
+	virtual void newDataAvailable(uint64_t amount, bool end_of_data);
+	virtual void resetRequested();
+	virtual void flushRequested();
+
+};
+
+}
+
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef AGL_ZSTD_DECOMPRESSOR_HPP
+#define AGL_ZSTD_DECOMPRESSOR_HPP
+
+#include "../Stream.hpp"
+
+namespace Agl
+{
+
+namespace Zstd
+{
+
+// Decompresses one Zstandard frame. Data after the frame is ignored.
+class Decompressor : public Stream
+{
+
+public:
+
+	Decompressor();
+	virtual ~Decompressor();
+
+private:
+
+	void* dctx;
+
+	bool frame_end;
+
+	virtual void newDataAvailable(uint64_t amount, bool end_of_data);
+	virtual void resetRequested();
+
+};
+
+}
+
+}
+
+#endif
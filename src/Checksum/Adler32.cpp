@@ -0,0 +1,147 @@
+#include "Checksum/Checksum.hpp"
+
+#include "Cpu.hpp"
+
+#ifdef AGL_CHECKSUM_X86
+#include <immintrin.h>
+#endif
+
+namespace Agl
+{
+
+namespace Checksum
+{
+
+namespace
+{
+
+uint32_t const BASE = 65521;
+// Most bytes that can be summed before sums must be reduced
+size_t const NMAX = 5552;
+
+uint32_t adler32Portable(uint8_t const* data, size_t size, uint32_t adler)
+{
+	uint32_t s1 = adler & 0xffff;
+	uint32_t s2 = adler >> 16;
+	while (size > 0) {
+		size_t block_size = size < NMAX ? size : NMAX;
+		size -= block_size;
+		while (block_size >= 4) {
+			s1 += data[0];
+			s2 += s1;
+			s1 += data[1];
+			s2 += s1;
+			s1 += data[2];
+			s2 += s1;
+			s1 += data[3];
+			s2 += s1;
+			data += 4;
+			block_size -= 4;
+		}
+		while (block_size > 0) {
+			s1 += *data;
+			s2 += s1;
+			++ data;
+			-- block_size;
+		}
+		s1 %= BASE;
+		s2 %= BASE;
+	}
+	return s1 | (s2 << 16);
+}
+
+#ifdef AGL_CHECKSUM_X86
+
+__attribute__((target("avx2")))
+uint32_t sumLanes(__m256i v)
+{
+	__m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(sum);
+}
+
+// Handles 32 bytes at a time. Within a block, s1 grows by the sum of the
+// bytes, and s2 by the bytes weighted by 32, 31, ..., 1, plus 32 times
+// s1 from before the block. The last part is summed separately in
+// "prev_s1", and multiplied once at the end.
+__attribute__((target("avx2")))
+uint32_t adler32Avx2(uint8_t const* data, size_t size, uint32_t adler)
+{
+	size_t const BLOCK_SIZE = 32;
+
+	uint32_t s1 = adler & 0xffff;
+	uint32_t s2 = adler >> 16;
+
+	__m256i const weights = _mm256_setr_epi8(
+		32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+		16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1
+	);
+	__m256i const ones = _mm256_set1_epi16(1);
+	__m256i const zero = _mm256_setzero_si256();
+
+	size_t blocks = size / BLOCK_SIZE;
+	size -= blocks * BLOCK_SIZE;
+	while (blocks > 0) {
+		size_t run = NMAX / BLOCK_SIZE;
+		if (run > blocks) run = blocks;
+		blocks -= run;
+
+		__m256i prev_s1 = _mm256_setr_epi32(s1 * run, 0, 0, 0, 0, 0, 0, 0);
+		__m256i v_s1 = zero;
+		__m256i v_s2 = _mm256_setr_epi32(s2, 0, 0, 0, 0, 0, 0, 0);
+		do {
+			__m256i bytes = _mm256_loadu_si256((__m256i const*)data);
+			prev_s1 = _mm256_add_epi32(prev_s1, v_s1);
+			v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(bytes, zero));
+			v_s2 = _mm256_add_epi32(v_s2, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, weights), ones));
+			data += BLOCK_SIZE;
+		} while (-- run);
+		v_s2 = _mm256_add_epi32(v_s2, _mm256_slli_epi32(prev_s1, 5));
+
+		s1 = (s1 + sumLanes(v_s1)) % BASE;
+		s2 = sumLanes(v_s2) % BASE;
+	}
+
+	return adler32Portable(data, size, s1 | (s2 << 16));
+}
+
+#endif
+
+typedef uint32_t (*Kernel)(uint8_t const* data, size_t size, uint32_t adler);
+
+Kernel pickAdler32Kernel()
+{
+#ifdef AGL_CHECKSUM_X86
+	if (cpuFeatures().avx2) {
+		return &adler32Avx2;
+	}
+#endif
+	return &adler32Portable;
+}
+
+}
+
+uint32_t adler32(uint8_t const* data, size_t size, uint32_t adler)
+{
+	static Kernel const kernel = pickAdler32Kernel();
+	return kernel(data, size, adler);
+}
+
+uint32_t adler32Combine(uint32_t adler1, uint32_t adler2, uint64_t size2)
+{
+	uint32_t rem = size2 % BASE;
+	uint32_t sum1 = adler1 & 0xffff;
+	uint32_t sum2 = uint64_t(rem) * sum1 % BASE;
+	sum1 += (adler2 & 0xffff) + BASE - 1;
+	sum2 += ((adler1 >> 16) & 0xffff) + ((adler2 >> 16) & 0xffff) + BASE - rem;
+	if (sum1 >= BASE) sum1 -= BASE;
+	if (sum1 >= BASE) sum1 -= BASE;
+	if (sum2 >= BASE * 2) sum2 -= BASE * 2;
+	if (sum2 >= BASE) sum2 -= BASE;
+	return sum1 | (sum2 << 16);
+}
+
+}
+
+}
@@ -0,0 +1,82 @@
+#include "Checksum/ChecksumStream.hpp"
+
+#include "Checksum/Checksum.hpp"
+
+#include <cstring>
+
+namespace Agl
+{
+
+namespace Checksum
+{
+
+ChecksumStream::ChecksumStream(Type type) :
+	type(type),
+	checksum(initialValue()),
+	total_size(0)
+{
+}
+
+uint32_t ChecksumStream::value() const
+{
+	return checksum;
+}
+
+uint64_t ChecksumStream::size() const
+{
+	return total_size;
+}
+
+void ChecksumStream::newDataAvailable(uint64_t amount, bool end_of_data)
+{
+	(void)amount;
+	(void)end_of_data;
+
+	// Small pieces stay in cache between checksumming and copying
+	size_t const PIECE_SIZE = 64 * 1024;
+
+	uint8_t const* input_begin;
+	size_t input_size;
+	while (!outputFull() && (input_size = viewInputData(input_begin)) > 0) {
+		if (input_size > PIECE_SIZE) {
+			input_size = PIECE_SIZE;
+		}
+		uint8_t* output_begin;
+		size_t output_size = reserveOutputData(output_begin, input_size);
+		if (output_size > input_size) {
+			output_size = input_size;
+		}
+
+		switch (type) {
+		case CRC32:
+			checksum = crc32(input_begin, output_size, checksum);
+			break;
+		case CRC32C:
+			checksum = crc32c(input_begin, output_size, checksum);
+			break;
+		case ADLER32:
+			checksum = adler32(input_begin, output_size, checksum);
+			break;
+		}
+		total_size += output_size;
+
+		memcpy(output_begin, input_begin, output_size);
+		commitOutputData(output_size);
+		consumeInputData(output_size);
+	}
+}
+
+void ChecksumStream::resetRequested()
+{
+	checksum = initialValue();
+	total_size = 0;
+}
+
+uint32_t ChecksumStream::initialValue() const
+{
+	return type == ADLER32 ? 1 : 0;
+}
+
+}
+
+}
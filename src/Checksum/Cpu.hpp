@@ -0,0 +1,61 @@
+#ifndef AGL_CHECKSUM_CPU_HPP
+#define AGL_CHECKSUM_CPU_HPP
+
+// SIMD kernels are compiled with target attributes, so no special
+// compiler flags are needed. They are used only if the processor and
+// the operating system support them.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define AGL_CHECKSUM_X86
+#include <cpuid.h>
+#endif
+
+namespace Agl
+{
+
+namespace Checksum
+{
+
+struct CpuFeatures
+{
+	// Carry-less multiplication, with SSE4.1
+	bool pclmul;
+	bool sse42;
+	bool avx2;
+};
+
+inline CpuFeatures detectCpuFeatures()
+{
+	CpuFeatures result = { false, false, false };
+#ifdef AGL_CHECKSUM_X86
+	unsigned eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+		return result;
+	}
+	result.pclmul = (ecx & (1 << 1)) && (ecx & (1 << 19));
+	result.sse42 = ecx & (1 << 20);
+
+	// AVX registers must be saved by the operating system. This
+	// needs OSXSAVE and AVX bits, and then XCR0 is checked.
+	if ((ecx & (1 << 27)) && (ecx & (1 << 28)) && __get_cpuid_max(0, NULL) >= 7) {
+		unsigned xcr0_low, xcr0_high;
+		__asm__("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+		if ((xcr0_low & 6) == 6) {
+			__cpuid_count(7, 0, eax, ebx, ecx, edx);
+			result.avx2 = ebx & (1 << 5);
+		}
+	}
+#endif
+	return result;
+}
+
+inline CpuFeatures const& cpuFeatures()
+{
+	static CpuFeatures const features = detectCpuFeatures();
+	return features;
+}
+
+}
+
+}
+
+#endif
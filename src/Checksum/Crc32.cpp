@@ -0,0 +1,355 @@
+#include "Checksum/Checksum.hpp"
+
+#include "Cpu.hpp"
+
+#ifdef AGL_CHECKSUM_X86
+#include <immintrin.h>
+#endif
+
+namespace Agl
+{
+
+namespace Checksum
+{
+
+namespace
+{
+
+// Reflected polynomials
+uint32_t const CRC32_POLY = 0xedb88320;
+uint32_t const CRC32C_POLY = 0x82f63b78;
+
+// Returns a * b modulo polynomial, in reflected bit order
+uint32_t multModP(uint32_t a, uint32_t b, uint32_t poly)
+{
+	uint32_t m = uint32_t(1) << 31;
+	uint32_t p = 0;
+	while (true) {
+		if (a & m) {
+			p ^= b;
+			if ((a & (m - 1)) == 0) {
+				break;
+			}
+		}
+		m >>= 1;
+		b = b & 1 ? (b >> 1) ^ poly : b >> 1;
+	}
+	return p;
+}
+
+struct CrcTables
+{
+	uint32_t poly;
+	// Tables for processing eight bytes at once
+	uint32_t slices[8][256];
+	// x^(2^n) modulo polynomial, for combining
+	uint32_t x2n[64];
+
+	CrcTables(uint32_t poly) :
+		poly(poly)
+	{
+		for (uint32_t byte = 0; byte < 256; ++ byte) {
+			uint32_t crc = byte;
+			for (int bit = 0; bit < 8; ++ bit) {
+				crc = crc & 1 ? (crc >> 1) ^ poly : crc >> 1;
+			}
+			slices[0][byte] = crc;
+		}
+		for (int slice = 1; slice < 8; ++ slice) {
+			for (int byte = 0; byte < 256; ++ byte) {
+				uint32_t prev = slices[slice - 1][byte];
+				slices[slice][byte] = (prev >> 8) ^ slices[0][prev & 0xff];
+			}
+		}
+
+		// Starts from x^1
+		x2n[0] = uint32_t(1) << 30;
+		for (int n = 1; n < 64; ++ n) {
+			x2n[n] = multModP(x2n[n - 1], x2n[n - 1], poly);
+		}
+	}
+
+	// Returns x^(8 * size) modulo polynomial
+	uint32_t shiftFactor(uint64_t size) const
+	{
+		uint32_t p = uint32_t(1) << 31;
+		// Bytes are eight bits, so start from x^8
+		int n = 3;
+		while (size) {
+			if (size & 1) {
+				p = multModP(x2n[n & 63], p, poly);
+			}
+			size >>= 1;
+			++ n;
+		}
+		return p;
+	}
+};
+
+CrcTables const& crc32Tables()
+{
+	static CrcTables const tables(CRC32_POLY);
+	return tables;
+}
+
+CrcTables const& crc32cTables()
+{
+	static CrcTables const tables(CRC32C_POLY);
+	return tables;
+}
+
+// Portable version. CRC is not inverted here.
+uint32_t crcSliced(CrcTables const& tables, uint8_t const* data, size_t size, uint32_t crc)
+{
+	uint32_t const (*t)[256] = tables.slices;
+	while (size >= 8) {
+		uint32_t low = crc ^ (uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24));
+		uint32_t high = uint32_t(data[4]) | (uint32_t(data[5]) << 8) | (uint32_t(data[6]) << 16) | (uint32_t(data[7]) << 24);
+		crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24] ^
+		      t[3][high & 0xff] ^ t[2][(high >> 8) & 0xff] ^ t[1][(high >> 16) & 0xff] ^ t[0][high >> 24];
+		data += 8;
+		size -= 8;
+	}
+	while (size > 0) {
+		crc = t[0][(crc ^ *data) & 0xff] ^ (crc >> 8);
+		++ data;
+		-- size;
+	}
+	return crc;
+}
+
+uint32_t crc32Portable(uint8_t const* data, size_t size, uint32_t crc)
+{
+	return ~crcSliced(crc32Tables(), data, size, ~crc);
+}
+
+uint32_t crc32cPortable(uint8_t const* data, size_t size, uint32_t crc)
+{
+	return ~crcSliced(crc32cTables(), data, size, ~crc);
+}
+
+#ifdef AGL_CHECKSUM_X86
+
+// Folds 64 bytes at a time with carry-less multiplication, and then
+// reduces to 32 bits. From "Fast CRC Computation for Generic Polynomials
+// Using PCLMULQDQ Instruction" by Gopal et al., 2009. Size must be at
+// least 64 and a multiple of 16. CRC is not inverted here.
+__attribute__((target("pclmul,sse4.1")))
+uint32_t crc32Fold(uint8_t const* data, size_t size, uint32_t crc)
+{
+	static uint64_t const k1k2[2] __attribute__((aligned(16))) = { 0x0154442bd4, 0x01c6e41596 };
+	static uint64_t const k3k4[2] __attribute__((aligned(16))) = { 0x01751997d0, 0x00ccaa009e };
+	static uint64_t const k5k0[2] __attribute__((aligned(16))) = { 0x0163cd6124, 0x0000000000 };
+	static uint64_t const poly[2] __attribute__((aligned(16))) = { 0x01db710641, 0x01f7011641 };
+
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+	x1 = _mm_loadu_si128((__m128i const*)(data + 0x00));
+	x2 = _mm_loadu_si128((__m128i const*)(data + 0x10));
+	x3 = _mm_loadu_si128((__m128i const*)(data + 0x20));
+	x4 = _mm_loadu_si128((__m128i const*)(data + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+	x0 = _mm_load_si128((__m128i const*)k1k2);
+	data += 64;
+	size -= 64;
+
+	// Fold four lanes in parallel
+	while (size >= 64) {
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((__m128i const*)(data + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((__m128i const*)(data + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((__m128i const*)(data + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((__m128i const*)(data + 0x30)));
+		data += 64;
+		size -= 64;
+	}
+
+	// Fold lanes into one
+	x0 = _mm_load_si128((__m128i const*)k3k4);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	// Fold rest of 16 byte blocks
+	while (size >= 16) {
+		x2 = _mm_loadu_si128((__m128i const*)data);
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+		data += 16;
+		size -= 16;
+	}
+
+	// Fold 128 bits to 64 bits
+	x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+	x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+	x1 = _mm_srli_si128(x1, 8);
+	x1 = _mm_xor_si128(x1, x2);
+	x0 = _mm_loadl_epi64((__m128i const*)k5k0);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, x3);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// Barrett reduction to 32 bits
+	x0 = _mm_load_si128((__m128i const*)poly);
+	x2 = _mm_and_si128(x1, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+	x2 = _mm_and_si128(x2, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return _mm_extract_epi32(x1, 1);
+}
+
+uint32_t crc32Pclmul(uint8_t const* data, size_t size, uint32_t crc)
+{
+	crc = ~crc;
+	if (size >= 64) {
+		size_t folded = size & ~size_t(15);
+		crc = crc32Fold(data, folded, crc);
+		data += folded;
+		size -= folded;
+	}
+	return ~crcSliced(crc32Tables(), data, size, crc);
+}
+
+// Instruction takes 64 bits at a time only in 64 bit mode
+#ifdef __x86_64__
+typedef uint64_t CrcWord;
+
+__attribute__((target("sse4.2")))
+inline CrcWord crc32cWord(CrcWord crc, CrcWord word)
+{
+	return _mm_crc32_u64(crc, word);
+}
+#else
+typedef uint32_t CrcWord;
+
+__attribute__((target("sse4.2")))
+inline CrcWord crc32cWord(CrcWord crc, CrcWord word)
+{
+	return _mm_crc32_u32(crc, word);
+}
+#endif
+
+__attribute__((target("sse4.2")))
+uint32_t crc32cHardwareLane(uint8_t const* data, size_t size, uint32_t crc)
+{
+	CrcWord crc_word = crc;
+	while (size >= sizeof(CrcWord)) {
+		CrcWord word;
+		__builtin_memcpy(&word, data, sizeof(CrcWord));
+		crc_word = crc32cWord(crc_word, word);
+		data += sizeof(CrcWord);
+		size -= sizeof(CrcWord);
+	}
+	crc = uint32_t(crc_word);
+	while (size > 0) {
+		crc = _mm_crc32_u8(crc, *data);
+		++ data;
+		-- size;
+	}
+	return crc;
+}
+
+// The instruction has latency of three cycles, but it can start every
+// cycle. So long data is split to three lanes that are computed at the
+// same time, and then combined.
+__attribute__((target("sse4.2")))
+uint32_t crc32cHardware(uint8_t const* data, size_t size, uint32_t crc)
+{
+	size_t const LANE_SIZE = 4096;
+
+	crc = ~crc;
+	if (size >= LANE_SIZE * 3) {
+		static uint32_t const shift1 = crc32cTables().shiftFactor(LANE_SIZE);
+		static uint32_t const shift2 = crc32cTables().shiftFactor(LANE_SIZE * 2);
+		uint32_t poly = CRC32C_POLY;
+		do {
+			CrcWord crc0 = crc;
+			CrcWord crc1 = 0;
+			CrcWord crc2 = 0;
+			for (size_t offset = 0; offset < LANE_SIZE; offset += sizeof(CrcWord)) {
+				CrcWord word0, word1, word2;
+				__builtin_memcpy(&word0, data + offset, sizeof(CrcWord));
+				__builtin_memcpy(&word1, data + LANE_SIZE + offset, sizeof(CrcWord));
+				__builtin_memcpy(&word2, data + LANE_SIZE * 2 + offset, sizeof(CrcWord));
+				crc0 = crc32cWord(crc0, word0);
+				crc1 = crc32cWord(crc1, word1);
+				crc2 = crc32cWord(crc2, word2);
+			}
+			crc = multModP(shift2, uint32_t(crc0), poly) ^ multModP(shift1, uint32_t(crc1), poly) ^ uint32_t(crc2);
+			data += LANE_SIZE * 3;
+			size -= LANE_SIZE * 3;
+		} while (size >= LANE_SIZE * 3);
+	}
+	return ~crc32cHardwareLane(data, size, crc);
+}
+
+#endif
+
+typedef uint32_t (*Kernel)(uint8_t const* data, size_t size, uint32_t crc);
+
+Kernel pickCrc32Kernel()
+{
+#ifdef AGL_CHECKSUM_X86
+	if (cpuFeatures().pclmul) {
+		return &crc32Pclmul;
+	}
+#endif
+	return &crc32Portable;
+}
+
+Kernel pickCrc32cKernel()
+{
+#ifdef AGL_CHECKSUM_X86
+	if (cpuFeatures().sse42) {
+		return &crc32cHardware;
+	}
+#endif
+	return &crc32cPortable;
+}
+
+}
+
+uint32_t crc32(uint8_t const* data, size_t size, uint32_t crc)
+{
+	static Kernel const kernel = pickCrc32Kernel();
+	return kernel(data, size, crc);
+}
+
+uint32_t crc32c(uint8_t const* data, size_t size, uint32_t crc)
+{
+	static Kernel const kernel = pickCrc32cKernel();
+	return kernel(data, size, crc);
+}
+
+uint32_t crc32Combine(uint32_t crc1, uint32_t crc2, uint64_t size2)
+{
+	CrcTables const& tables = crc32Tables();
+	return multModP(tables.shiftFactor(size2), crc1, tables.poly) ^ crc2;
+}
+
+uint32_t crc32cCombine(uint32_t crc1, uint32_t crc2, uint64_t size2)
+{
+	CrcTables const& tables = crc32cTables();
+	return multModP(tables.shiftFactor(size2), crc1, tables.poly) ^ crc2;
+}
+
+}
+
+}
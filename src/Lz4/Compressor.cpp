@@ -0,0 +1,145 @@
+#include "Lz4/Compressor.hpp"
+
+#include <lz4frame.h>
+#include <lz4hc.h>
+#include <stdexcept>
+#include <string>
+
+namespace Agl
+{
+
+namespace Lz4
+{
+
+namespace
+{
+
+// Input is given to LZ4 in pieces of this size, so
+// that the worst case output size stays reasonable.
+size_t const INPUT_CHUNK_SIZE = 64 * 1024;
+
+int toLz4Level(Compressor::Level level)
+{
+	switch (level) {
+	case Compressor::FAST:
+		// Negative levels trade ratio for even more speed
+		return -4;
+	case Compressor::BEST:
+		return LZ4HC_CLEVEL_MAX;
+	default:
+		return 0;
+	}
+}
+
+size_t check(size_t code)
+{
+	if (LZ4F_isError(code)) {
+		throw std::runtime_error(std::string("LZ4 error: ") + LZ4F_getErrorName(code) + "!");
+	}
+	return code;
+}
+
+}
+
+Compressor::Compressor(Level level) :
+	frame_started(false),
+	frame_ended(false),
+	pending_flush(false)
+{
+	LZ4F_preferences_t* lz4_prefs = new LZ4F_preferences_t();
+	lz4_prefs->compressionLevel = toLz4Level(level);
+	lz4_prefs->frameInfo.blockSizeID = LZ4F_max64KB;
+	lz4_prefs->frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+	prefs = lz4_prefs;
+
+	LZ4F_cctx* lz4_cctx;
+	if (LZ4F_isError(LZ4F_createCompressionContext(&lz4_cctx, LZ4F_VERSION))) {
+		delete lz4_prefs;
+		throw std::bad_alloc();
+	}
+	cctx = lz4_cctx;
+}
+
+Compressor::~Compressor()
+{
+	LZ4F_freeCompressionContext((LZ4F_cctx*)cctx);
+	delete (LZ4F_preferences_t*)prefs;
+}
+
+void Compressor::newDataAvailable(uint64_t amount, bool end_of_data)
+{
+	(void)amount;
+
+	LZ4F_cctx* lz4_cctx = (LZ4F_cctx*)cctx;
+	LZ4F_preferences_t* lz4_prefs = (LZ4F_preferences_t*)prefs;
+
+	if (!frame_started) {
+		writeOutput(LZ4F_HEADER_SIZE_MAX, [&](uint8_t* output_begin, size_t output_size) {
+			return check(LZ4F_compressBegin(lz4_cctx, output_begin, output_size, lz4_prefs));
+		});
+		frame_started = true;
+	}
+
+	// Compress input data in pieces, until output gets full
+	uint8_t const* input_begin;
+	size_t input_size;
+	while (!outputFull() && (input_size = viewInputData(input_begin)) > 0) {
+		if (input_size > INPUT_CHUNK_SIZE) {
+			input_size = INPUT_CHUNK_SIZE;
+		}
+		writeOutput(LZ4F_compressBound(input_size, lz4_prefs), [&](uint8_t* output_begin, size_t output_size) {
+			return check(LZ4F_compressUpdate(lz4_cctx, output_begin, output_size, input_begin, input_size, NULL));
+		});
+		consumeInputData(input_size);
+	}
+
+	// Flushing and ending wait until all input is compressed
+	if (inputDataSize() > 0 || outputFull()) {
+		return;
+	}
+	if (end_of_data && !frame_ended) {
+		writeOutput(LZ4F_compressBound(0, lz4_prefs), [&](uint8_t* output_begin, size_t output_size) {
+			return check(LZ4F_compressEnd(lz4_cctx, output_begin, output_size, NULL));
+		});
+		frame_ended = true;
+		pending_flush = false;
+	} else if (pending_flush) {
+		writeOutput(LZ4F_compressBound(0, lz4_prefs), [&](uint8_t* output_begin, size_t output_size) {
+			return check(LZ4F_flush(lz4_cctx, output_begin, output_size, NULL));
+		});
+		pending_flush = false;
+	}
+}
+
+void Compressor::resetRequested()
+{
+	// Next frame restarts the context
+	frame_started = false;
+	frame_ended = false;
+	pending_flush = false;
+}
+
+void Compressor::flushRequested()
+{
+	pending_flush = true;
+}
+
+template< typename Function >
+void Compressor::writeOutput(size_t max_size, Function function)
+{
+	// LZ4 needs room for the worst case. Write directly
+	// to output buffer, if it has contiguous room for it.
+	uint8_t* output_begin;
+	size_t output_size = reserveOutputData(output_begin, max_size);
+	if (output_size >= max_size) {
+		commitOutputData(function(output_begin, output_size));
+	} else {
+		scratch.resize(max_size);
+		size_t size = function(scratch.data(), scratch.size());
+		writeOutputData(scratch.data(), scratch.data() + size);
+	}
+}
+
+}
+
+}
@@ -0,0 +1,76 @@
+#include "Lz4/Decompressor.hpp"
+
+#include <lz4frame.h>
+#include <stdexcept>
+
+namespace Agl
+{
+
+namespace Lz4
+{
+
+Decompressor::Decompressor() :
+	frame_end(false)
+{
+	LZ4F_dctx* lz4_dctx;
+	if (LZ4F_isError(LZ4F_createDecompressionContext(&lz4_dctx, LZ4F_VERSION))) {
+		throw std::bad_alloc();
+	}
+	dctx = lz4_dctx;
+}
+
+Decompressor::~Decompressor()
+{
+	LZ4F_freeDecompressionContext((LZ4F_dctx*)dctx);
+}
+
+void Decompressor::newDataAvailable(uint64_t amount, bool end_of_data)
+{
+	(void)amount;
+
+	size_t const OUTPUT_CHUNK_SIZE = 64 * 1024;
+
+	// Decompress directly to output buffer, until output gets full. This
+	// is done also when there is no input, because LZ4 might still have
+	// some pending output from the time output got full.
+	while (!frame_end && !outputFull()) {
+		uint8_t const* input_begin;
+		size_t input_size = viewInputData(input_begin);
+		uint8_t* output_begin;
+		size_t output_size = reserveOutputData(output_begin, OUTPUT_CHUNK_SIZE);
+
+		size_t hint = LZ4F_decompress((LZ4F_dctx*)dctx, output_begin, &output_size, input_size > 0 ? input_begin : NULL, &input_size, NULL);
+		if (LZ4F_isError(hint)) {
+			throw std::runtime_error("Corrupted data!");
+		}
+		consumeInputData(input_size);
+		commitOutputData(output_size);
+
+		// Zero hint means that the frame is complete
+		if (hint == 0) {
+			frame_end = true;
+		}
+		if (input_size == 0 && output_size == 0) {
+			break;
+		}
+	}
+
+	// Data after the end of frame is ignored
+	if (frame_end) {
+		consumeInputData(inputDataSize());
+	}
+
+	if (end_of_data && !frame_end && inputDataSize() == 0 && !outputFull()) {
+		throw std::runtime_error("Unexpected end of compressed data!");
+	}
+}
+
+void Decompressor::resetRequested()
+{
+	LZ4F_resetDecompressionContext((LZ4F_dctx*)dctx);
+	frame_end = false;
+}
+
+}
+
+}
@@ -0,0 +1,91 @@
+#include "Zlib/ArenaAllocator.hpp"
+
+#include <new>
+
+namespace Agl
+{
+
+namespace Zlib
+{
+
+namespace
+{
+
+// All allocations are aligned like this
+size_t const ALIGNMENT = 16;
+
+}
+
+ArenaAllocator::ArenaAllocator(size_t block_size) :
+	block_size(block_size),
+	block_pos(0),
+	total_used(0)
+{
+}
+
+ArenaAllocator::~ArenaAllocator()
+{
+	for (Blocks::iterator it = blocks.begin(); it != blocks.end(); ++ it) {
+		::operator delete(it->data);
+	}
+}
+
+void* ArenaAllocator::allocate(size_t items, size_t size)
+{
+	if (size != 0 && items > size_t(-1) / size) {
+		return NULL;
+	}
+	size_t amount = (items * size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	if (amount == 0) amount = ALIGNMENT;
+
+	if (blocks.empty() || blocks.back().size - block_pos < amount) {
+		Block block;
+		block.size = amount > block_size ? amount : block_size;
+		block.data = static_cast< uint8_t* >(::operator new(block.size, std::nothrow));
+		if (!block.data) {
+			return NULL;
+		}
+		blocks.push_back(block);
+		block_pos = 0;
+	}
+
+	void* result = blocks.back().data + block_pos;
+	block_pos += amount;
+	total_used += amount;
+	return result;
+}
+
+void ArenaAllocator::deallocate(void* ptr)
+{
+	(void)ptr;
+}
+
+void ArenaAllocator::reset()
+{
+	for (size_t block_i = 1; block_i < blocks.size(); ++ block_i) {
+		::operator delete(blocks[block_i].data);
+	}
+	if (blocks.size() > 1) {
+		blocks.resize(1);
+	}
+	block_pos = 0;
+	total_used = 0;
+}
+
+size_t ArenaAllocator::used() const
+{
+	return total_used;
+}
+
+size_t ArenaAllocator::reserved() const
+{
+	size_t result = 0;
+	for (Blocks::const_iterator it = blocks.begin(); it != blocks.end(); ++ it) {
+		result += it->size;
+	}
+	return result;
+}
+
+}
+
+}
@@ -0,0 +1,47 @@
+#include "Zlib/Batch.hpp"
+
+#include "Zlib/Compress.hpp"
+
+namespace Agl
+{
+
+namespace Zlib
+{
+
+Batch::Batch(size_t threads) :
+	pool(threads),
+	buffers(pool.workerCount())
+{
+}
+
+std::vector< Bytes > Batch::compress(std::vector< Bytes > const& inputs, Deflator::Level level)
+{
+	std::vector< Bytes > results(inputs.size());
+	pool.run(inputs.size(), [&](size_t index, size_t worker) {
+		Bytes const& input = inputs[index];
+		Bytes& buffer = buffers[worker];
+		size_t max_size = maxCompressedSize(input.size());
+		if (buffer.size() < max_size) {
+			buffer.resize(max_size);
+		}
+		size_t size = compressInto(input.data(), input.size(), buffer.data(), buffer.size(), level);
+		results[index].assign(buffer.begin(), buffer.begin() + size);
+	});
+	return results;
+}
+
+std::vector< Bytes > Batch::decompress(std::vector< Bytes > const& inputs)
+{
+	std::vector< Bytes > results(inputs.size());
+	pool.run(inputs.size(), [&](size_t index, size_t worker) {
+		Bytes const& input = inputs[index];
+		Bytes& buffer = buffers[worker];
+		size_t size = decompressInto(input.data(), input.size(), buffer);
+		results[index].assign(buffer.begin(), buffer.begin() + size);
+	});
+	return results;
+}
+
+}
+
+}
@@ -0,0 +1,92 @@
+#ifndef AGL_ZLIB_COMMON_HPP
+#define AGL_ZLIB_COMMON_HPP
+
+#include "Zlib/Allocator.hpp"
+#include "Zlib/Deflator.hpp"
+
+#include <zlib.h>
+
+namespace Agl
+{
+
+namespace Zlib
+{
+
+// Size of deflate window, and therefore the maximum useful dictionary
+size_t const WINDOW_SIZE = 32 * 1024;
+
+// Converts compression level to the one used by zlib
+inline int toZlibLevel(Deflator::Level level)
+{
+	switch (level) {
+	case Deflator::NO_COMPRESSION:
+		return Z_NO_COMPRESSION;
+	case Deflator::FAST:
+		return Z_BEST_SPEED;
+	case Deflator::BEST:
+		return Z_BEST_COMPRESSION;
+	default:
+		return Z_DEFAULT_COMPRESSION;
+	}
+}
+
+inline int toZlibStrategy(Deflator::Strategy strategy)
+{
+	switch (strategy) {
+	case Deflator::FILTERED:
+		return Z_FILTERED;
+	case Deflator::HUFFMAN_ONLY:
+		return Z_HUFFMAN_ONLY;
+	case Deflator::RLE:
+		return Z_RLE;
+	case Deflator::FIXED:
+		return Z_FIXED;
+	default:
+		return Z_DEFAULT_STRATEGY;
+	}
+}
+
+inline int toZlibFlush(Deflator::FlushMode mode)
+{
+	switch (mode) {
+	case Deflator::PARTIAL_FLUSH:
+		return Z_PARTIAL_FLUSH;
+	case Deflator::SYNC_FLUSH:
+		return Z_SYNC_FLUSH;
+	case Deflator::FULL_FLUSH:
+		return Z_FULL_FLUSH;
+	default:
+		return Z_NO_FLUSH;
+	}
+}
+
+inline voidpf allocateWithAllocator(voidpf opaque, uInt items, uInt size)
+{
+	return static_cast< Allocator* >(opaque)->allocate(items, size);
+}
+
+inline void deallocateWithAllocator(voidpf opaque, voidpf address)
+{
+	static_cast< Allocator* >(opaque)->deallocate(address);
+}
+
+// Makes zstream use "allocator", or malloc if it is NULL.
+// Must be called before zstream is initialized.
+inline void setAllocator(z_streamp zstrm, Allocator* allocator)
+{
+	if (allocator) {
+		zstrm->zalloc = &allocateWithAllocator;
+		zstrm->zfree = &deallocateWithAllocator;
+		zstrm->opaque = allocator;
+	} else {
+		zstrm->zalloc = Z_NULL;
+		zstrm->zfree = Z_NULL;
+		zstrm->opaque = Z_NULL;
+	}
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,250 @@
+#include "Zlib/Compress.hpp"
+
+#include "Common.hpp"
+
+#include <stdexcept>
+#include <zlib.h>
+
+namespace Agl
+{
+
+namespace Zlib
+{
+
+namespace
+{
+
+// Size of input and output given to zlib at once, because it uses 32 bit sizes
+size_t const MAX_CHUNK_SIZE = uInt(-1);
+
+// Resetting deflate clears its whole hash table, which takes
+// most of the time with small inputs. So small inputs use
+// smaller tables, and each table size has its own state.
+int const LARGEST_MEM_LEVEL = 8;
+
+int memLevelFor(size_t size)
+{
+	int mem_level = 1;
+	while (mem_level < LARGEST_MEM_LEVEL && (size_t(1) << (mem_level + 7)) < size) {
+		++ mem_level;
+	}
+	return mem_level;
+}
+
+// Zlib state that is reused by all calls in one thread
+class DeflateContext
+{
+public:
+	DeflateContext() : initialized(false), level(0) { }
+	~DeflateContext() { if (initialized) deflateEnd(&zstrm); }
+
+	z_streamp get(int level, int mem_level)
+	{
+		if (initialized && this->level != level) {
+			deflateEnd(&zstrm);
+			initialized = false;
+		}
+		if (initialized) {
+			deflateReset(&zstrm);
+			return &zstrm;
+		}
+		zstrm.zalloc = Z_NULL;
+		zstrm.zfree = Z_NULL;
+		zstrm.opaque = Z_NULL;
+		int err = deflateInit2(&zstrm, level, Z_DEFLATED, 15, mem_level, Z_DEFAULT_STRATEGY);
+		if (err == Z_MEM_ERROR) {
+			throw std::bad_alloc();
+		}
+		if (err != Z_OK) {
+			throw std::runtime_error("Unable to initialize zlib deflate()!");
+		}
+		initialized = true;
+		this->level = level;
+		return &zstrm;
+	}
+
+private:
+	z_stream zstrm;
+	bool initialized;
+	int level;
+};
+
+class InflateContext
+{
+public:
+	InflateContext() : initialized(false) { }
+	~InflateContext() { if (initialized) inflateEnd(&zstrm); }
+
+	z_streamp get()
+	{
+		if (initialized) {
+			inflateReset(&zstrm);
+			return &zstrm;
+		}
+		zstrm.zalloc = Z_NULL;
+		zstrm.zfree = Z_NULL;
+		zstrm.opaque = Z_NULL;
+		zstrm.next_in = Z_NULL;
+		zstrm.avail_in = 0;
+		// Accept both zlib and gzip headers
+		int err = inflateInit2(&zstrm, 15 + 32);
+		if (err == Z_MEM_ERROR) {
+			throw std::bad_alloc();
+		}
+		if (err != Z_OK) {
+			throw std::runtime_error("Unable to initialize zlib inflate()!");
+		}
+		initialized = true;
+		return &zstrm;
+	}
+
+private:
+	z_stream zstrm;
+	bool initialized;
+};
+
+thread_local DeflateContext deflate_contexts[LARGEST_MEM_LEVEL];
+thread_local InflateContext inflate_context;
+
+z_streamp deflateContext(Deflator::Level level, size_t size)
+{
+	int mem_level = memLevelFor(size);
+	return deflate_contexts[mem_level - 1].get(toZlibLevel(level), mem_level);
+}
+
+// Runs deflate or inflate, until stream ends, or output is full. Returns
+// true if stream ended. Input and output are given in chunks that fit zlib.
+template< typename Function >
+bool runOneShot(z_streamp zstrm, Function function, uint8_t const* data, size_t size, uint8_t* result, size_t capacity, size_t& read, size_t& written)
+{
+	// Zlib refuses null pointers, even if there is nothing to read or write
+	uint8_t dummy;
+	if (!data) {
+		data = &dummy;
+	}
+	if (!result) {
+		result = &dummy;
+	}
+
+	read = 0;
+	written = 0;
+	while (true) {
+		size_t in_chunk = size - read < MAX_CHUNK_SIZE ? size - read : MAX_CHUNK_SIZE;
+		size_t out_chunk = capacity - written < MAX_CHUNK_SIZE ? capacity - written : MAX_CHUNK_SIZE;
+		zstrm->next_in = (Bytef*)data + read;
+		zstrm->avail_in = in_chunk;
+		zstrm->next_out = result + written;
+		zstrm->avail_out = out_chunk;
+
+		int err = function(zstrm, read + in_chunk == size ? Z_FINISH : Z_NO_FLUSH);
+		read += in_chunk - zstrm->avail_in;
+		written += out_chunk - zstrm->avail_out;
+
+		if (err == Z_STREAM_END) {
+			return true;
+		}
+		if (err == Z_DATA_ERROR) {
+			throw std::runtime_error("Corrupted data!");
+		}
+		if (err == Z_NEED_DICT) {
+			throw std::runtime_error("Compressed data requires a dictionary!");
+		}
+		if (err == Z_MEM_ERROR) {
+			throw std::bad_alloc();
+		}
+		if (err == Z_STREAM_ERROR) {
+			throw std::runtime_error("Stream error in zlib!");
+		}
+		if (written == capacity) {
+			return false;
+		}
+		// No progress was possible, although there is room for output
+		if (err == Z_BUF_ERROR) {
+			throw std::runtime_error("Unexpected end of compressed data!");
+		}
+	}
+}
+
+}
+
+size_t maxCompressedSize(size_t size)
+{
+	// Bound of zlib does not cover the stored blocks of
+	// huge inputs, so add their headers here separately.
+	return size + size / 1000 + (size / 16383 + 1) * 5 + 64;
+}
+
+Bytes compress(uint8_t const* data, size_t size, Deflator::Level level)
+{
+	z_streamp zstrm = deflateContext(level, size);
+	Bytes result(size <= MAX_CHUNK_SIZE ? deflateBound(zstrm, size) : maxCompressedSize(size));
+	size_t read, written;
+	if (!runOneShot(zstrm, &deflate, data, size, result.data(), result.size(), read, written)) {
+		throw std::runtime_error("Compressed data does not fit!");
+	}
+	result.resize(written);
+	return result;
+}
+
+Bytes compress(Bytes const& data, Deflator::Level level)
+{
+	return compress(data.data(), data.size(), level);
+}
+
+size_t compressInto(uint8_t const* data, size_t size, uint8_t* result, size_t capacity, Deflator::Level level)
+{
+	z_streamp zstrm = deflateContext(level, size);
+	size_t read, written;
+	if (!runOneShot(zstrm, &deflate, data, size, result, capacity, read, written)) {
+		throw std::runtime_error("Compressed data does not fit!");
+	}
+	return written;
+}
+
+Bytes decompress(uint8_t const* data, size_t size, size_t size_hint)
+{
+	// Exact hint needs one more byte, to see that the stream ends there
+	Bytes result(size_hint > 0 ? size_hint + 1 : size * 4 + 64);
+	result.resize(decompressInto(data, size, result));
+	return result;
+}
+
+Bytes decompress(Bytes const& data, size_t size_hint)
+{
+	return decompress(data.data(), data.size(), size_hint);
+}
+
+size_t decompressInto(uint8_t const* data, size_t size, Bytes& buffer)
+{
+	z_streamp zstrm = inflate_context.get();
+
+	if (buffer.empty()) {
+		buffer.resize(size * 4 + 64);
+	}
+	size_t read = 0;
+	size_t written = 0;
+	while (true) {
+		size_t chunk_read, chunk_written;
+		bool ended = runOneShot(zstrm, &inflate, data + read, size - read, buffer.data() + written, buffer.size() - written, chunk_read, chunk_written);
+		read += chunk_read;
+		written += chunk_written;
+		if (ended) {
+			return written;
+		}
+		buffer.resize(buffer.size() * 2);
+	}
+}
+
+size_t decompressInto(uint8_t const* data, size_t size, uint8_t* result, size_t capacity)
+{
+	z_streamp zstrm = inflate_context.get();
+	size_t read, written;
+	if (!runOneShot(zstrm, &inflate, data, size, result, capacity, read, written)) {
+		throw std::runtime_error("Decompressed data does not fit!");
+	}
+	return written;
+}
+
+}
+
+}
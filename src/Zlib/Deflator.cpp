@@ -1,5 +1,8 @@
 #include "Zlib/Deflator.hpp"
 
+#include "Common.hpp"
+
+#include <chrono>
 #include <zlib.h>
 
 namespace Agl
@@ -8,42 +11,75 @@ namespace Agl
 namespace Zlib
 {
 
-Deflator::Deflator(Level level)
+namespace
+{
+
+size_t const OUTPUT_CHUNK_SIZE = 16 * 1024;
+
+// Level that zlib uses for Z_DEFAULT_COMPRESSION
+int const DEFAULT_ZLIB_LEVEL = 6;
+
+// In adaptive mode, input is compressed in pieces of this size, and
+// level is picked again after this much input has been compressed.
+size_t const ADAPTIVE_PIECE_SIZE = 64 * 1024;
+uint64_t const ADAPTIVE_WINDOW_SIZE = 256 * 1024;
+// Level is raised only if limits are met by this much, so
+// that it does not swing back and forth between two levels.
+double const ADAPTIVE_RAISE_MARGIN = 1.5;
+
+uint64_t nanosecondsNow()
+{
+	return std::chrono::duration_cast< std::chrono::nanoseconds >(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+Deflator::Options::Options(Level level) :
+	level(toZlibLevel(level)),
+	window_bits(15),
+	mem_level(8),
+	strategy(DEFAULT_STRATEGY)
+{
+}
+
+Deflator::Deflator(Level level, Allocator* allocator) :
+	Deflator(Options(level), allocator)
+{
+}
+
+Deflator::Deflator(Options const& options, Allocator* allocator) :
+	flush_mode(NO_FLUSH),
+	pending_flush(Z_NO_FLUSH),
+	zlib_level(options.level == Z_DEFAULT_COMPRESSION ? DEFAULT_ZLIB_LEVEL : options.level),
+	zlib_strategy(toZlibStrategy(options.strategy)),
+	wanted_level(zlib_level),
+	wanted_strategy(zlib_strategy),
+	target_throughput(0),
+	cpu_budget(0),
+	window_bytes(0),
+	window_nanoseconds(0),
+	window_started(0)
 {
 	zstrm = new z_stream;
 	// Tune allocation of zstream
-	z_streamp(zstrm)->zalloc = Z_NULL;
-	z_streamp(zstrm)->zfree = Z_NULL;
+	setAllocator(z_streamp(zstrm), allocator);
 	// Disable buffers at first
 	z_streamp(zstrm)->next_in = Z_NULL;
 	z_streamp(zstrm)->avail_in = 0;
 	z_streamp(zstrm)->next_out = Z_NULL;
 	z_streamp(zstrm)->avail_out = 0;
 
-	int zlevel;
-	switch (level) {
-	case NO_COMPRESSION:
-		zlevel = Z_NO_COMPRESSION;
-		break;
-	case FAST:
-		zlevel = Z_BEST_SPEED;
-		break;
-	case DEFAULT_COMPRESSION:
-		zlevel = Z_DEFAULT_COMPRESSION;
-		break;
-	case BEST:
-		zlevel = Z_BEST_COMPRESSION;
-		break;
-	}
-
-	int err = deflateInit(z_streamp(zstrm), zlevel);
+	int err = deflateInit2(z_streamp(zstrm), zlib_level, Z_DEFLATED, options.window_bits, options.mem_level, zlib_strategy);
 	if (err == Z_MEM_ERROR) {
+		delete z_streamp(zstrm);
 		throw std::bad_alloc();
 	}
 	if (err == Z_STREAM_ERROR) {
-		throw std::runtime_error("Invalid compression level!");
+		delete z_streamp(zstrm);
+		throw std::runtime_error("Invalid compression options!");
 	}
 	if (err == Z_VERSION_ERROR) {
+		delete z_streamp(zstrm);
 		throw std::runtime_error("Invalid zlib version!");
 	}
 }
@@ -54,43 +90,218 @@ Deflator::~Deflator()
 	delete z_streamp(zstrm);
 }
 
+double Deflator::compressionRatio() const
+{
+	uLong compressed = z_streamp(zstrm)->total_out;
+	if (compressed == 0) return 0;
+	return double(z_streamp(zstrm)->total_in) / double(compressed);
+}
+
+void Deflator::setDictionary(Bytes const& dictionary)
+{
+	if (dictionary.empty()) {
+		throw std::runtime_error("Dictionary is empty!");
+	}
+	int err = deflateSetDictionary(z_streamp(zstrm), dictionary.data(), dictionary.size());
+	if (err == Z_STREAM_ERROR) {
+		throw std::runtime_error("Dictionary must be set before data is pushed!");
+	}
+	this->dictionary = dictionary;
+}
+
+void Deflator::setFlushMode(FlushMode mode)
+{
+	flush_mode = mode;
+}
+
+void Deflator::setParams(int level, Strategy strategy)
+{
+	if (level < Z_DEFAULT_COMPRESSION || level > Z_BEST_COMPRESSION) {
+		throw std::runtime_error("Invalid compression level!");
+	}
+	wanted_level = level == Z_DEFAULT_COMPRESSION ? DEFAULT_ZLIB_LEVEL : level;
+	wanted_strategy = toZlibStrategy(strategy);
+}
+
+int Deflator::level() const
+{
+	return zlib_level;
+}
+
+void Deflator::setAdaptive(double target_throughput, double cpu_budget)
+{
+	// Written like this to reject NaN too
+	if (!(target_throughput >= 0) || !(cpu_budget >= 0)) {
+		throw std::runtime_error("Invalid limits for adaptive compression level!");
+	}
+	this->target_throughput = target_throughput;
+	this->cpu_budget = cpu_budget;
+	window_bytes = 0;
+	window_nanoseconds = 0;
+	window_started = 0;
+	if (target_throughput > 0 || cpu_budget > 0) {
+		if (wanted_level < Z_BEST_SPEED) wanted_level = Z_BEST_SPEED;
+	}
+}
+
 void Deflator::newDataAvailable(uint64_t amount, bool end_of_data)
 {
 	(void)amount;
 
-	Bytes bytes;
-	readInputData(bytes);
+	bool adaptive = target_throughput > 0 || cpu_budget > 0;
 
-	size_t OUTPUT_BUF_SIZE = 16 * 1024;
-	uint8_t output_buf[OUTPUT_BUF_SIZE];
+	// Compress input data in place, until output gets full. In adaptive
+	// mode this is done in pieces, so that level can follow the load.
+	uint8_t const* input_begin;
+	size_t input_size;
+	bool compressed = false;
+	while (!outputFull() && (input_size = viewInputData(input_begin)) > 0) {
+		if (!applyParams()) {
+			break;
+		}
+		if (adaptive && input_size > ADAPTIVE_PIECE_SIZE) {
+			input_size = ADAPTIVE_PIECE_SIZE;
+		}
+		uint64_t started = adaptive ? nanosecondsNow() : 0;
+		z_streamp(zstrm)->next_in = (Bytef*)input_begin;
+		z_streamp(zstrm)->avail_in = input_size;
+		runDeflate(Z_NO_FLUSH);
+		size_t consumed = input_size - z_streamp(zstrm)->avail_in;
+		consumeInputData(consumed);
+		compressed = true;
+		if (adaptive) {
+			adaptLevel(consumed, nanosecondsNow() - started);
+		}
+	}
+	z_streamp(zstrm)->next_in = Z_NULL;
+	z_streamp(zstrm)->avail_in = 0;
 
-	z_streamp(zstrm)->next_in = &bytes[0];
-	z_streamp(zstrm)->avail_in = bytes.size();
-	z_streamp(zstrm)->next_out = output_buf;
-	z_streamp(zstrm)->avail_out = OUTPUT_BUF_SIZE;
+	if (compressed && flush_mode != NO_FLUSH) {
+		pending_flush = toZlibFlush(flush_mode);
+	}
+	if (pending_flush != Z_NO_FLUSH && inputDataSize() == 0 && !outputFull()) {
+		if (runDeflate(pending_flush)) {
+			pending_flush = Z_NO_FLUSH;
+		}
+	}
+
+	if (end_of_data && inputDataSize() == 0 && pending_flush == Z_NO_FLUSH && !outputFull()) {
+		runDeflate(Z_FINISH);
+	}
+}
+
+void Deflator::resetRequested()
+{
+	if (deflateReset(z_streamp(zstrm)) != Z_OK) {
+		throw std::runtime_error("Unable to reset zlib deflate()!");
+	}
+	if (!dictionary.empty() && deflateSetDictionary(z_streamp(zstrm), dictionary.data(), dictionary.size()) != Z_OK) {
+		throw std::runtime_error("Unable to set dictionary of zlib deflate()!");
+	}
+	pending_flush = Z_NO_FLUSH;
+	window_bytes = 0;
+	window_nanoseconds = 0;
+	window_started = 0;
+}
+
+void Deflator::flushRequested()
+{
+	pending_flush = flush_mode != NO_FLUSH ? toZlibFlush(flush_mode) : Z_SYNC_FLUSH;
+}
 
+bool Deflator::runDeflate(int flush)
+{
 	while (true) {
-		int err = deflate(z_streamp(zstrm), end_of_data ? Z_FINISH : Z_NO_FLUSH);
+		// Compress directly to output buffer
+		uint8_t* output_begin;
+		size_t output_size = reserveOutputData(output_begin, OUTPUT_CHUNK_SIZE);
+		z_streamp(zstrm)->next_out = output_begin;
+		z_streamp(zstrm)->avail_out = output_size;
+
+		int err = deflate(z_streamp(zstrm), flush);
 		if (err == Z_STREAM_ERROR) {
 			throw std::runtime_error("Stream error in zlib deflate()!");
 		}
-		if (err == Z_BUF_ERROR) {
+		if (err == Z_BUF_ERROR && flush == Z_FINISH) {
 			throw std::runtime_error("Buffer error in zlib deflate()!");
 		}
 
-		// Read everything from output buffer
-		writeOutputData(output_buf, z_streamp(zstrm)->next_out);
+		commitOutputData(output_size - z_streamp(zstrm)->avail_out);
 
-		if ((!end_of_data && z_streamp(zstrm)->avail_in == 0) ||
-		    (end_of_data && err == Z_STREAM_END)) {
-			break;
+		// Z_BUF_ERROR means no progress was possible, which is not fatal
+		if (err == Z_STREAM_END || err == Z_BUF_ERROR) {
+			return true;
+		}
+		if (flush == Z_NO_FLUSH && z_streamp(zstrm)->avail_in == 0) {
+			return true;
+		}
+		// Flushing is complete, when zlib does not fill the output
+		if (flush != Z_NO_FLUSH && flush != Z_FINISH && z_streamp(zstrm)->avail_out != 0) {
+			return true;
 		}
+		// Rest is done when output has been read
+		if (outputFull()) {
+			return false;
+		}
+	}
+}
+
+bool Deflator::applyParams()
+{
+	while (wanted_level != zlib_level || wanted_strategy != zlib_strategy) {
+		// Zlib compresses pending data with old parameters first
+		uint8_t* output_begin;
+		size_t output_size = reserveOutputData(output_begin, OUTPUT_CHUNK_SIZE);
+		z_streamp(zstrm)->next_out = output_begin;
+		z_streamp(zstrm)->avail_out = output_size;
+
+		int err = deflateParams(z_streamp(zstrm), wanted_level, wanted_strategy);
+		commitOutputData(output_size - z_streamp(zstrm)->avail_out);
+
+		if (err == Z_OK) {
+			zlib_level = wanted_level;
+			zlib_strategy = wanted_strategy;
+		} else if (err == Z_BUF_ERROR && z_streamp(zstrm)->avail_out == 0) {
+			// Rest is done when output has been read
+			if (outputFull()) {
+				return false;
+			}
+		} else {
+			throw std::runtime_error("Unable to change compression parameters!");
+		}
+	}
+	return true;
+}
+
+void Deflator::adaptLevel(uint64_t bytes, uint64_t nanoseconds)
+{
+	uint64_t now = nanosecondsNow();
+	if (window_started == 0) {
+		window_started = now - nanoseconds;
+	}
+	window_bytes += bytes;
+	window_nanoseconds += nanoseconds;
+	if (window_bytes < ADAPTIVE_WINDOW_SIZE) {
+		return;
+	}
+
+	double seconds = window_nanoseconds > 0 ? window_nanoseconds / 1e9 : 1e-9;
+	double throughput = window_bytes / seconds;
+	double cpu_share = double(window_nanoseconds) / double(now > window_started ? now - window_started : 1);
 
-		// Reset output buffer
-		z_streamp(zstrm)->next_out = output_buf;
-		z_streamp(zstrm)->avail_out = OUTPUT_BUF_SIZE;
+	bool too_slow = (target_throughput > 0 && throughput < target_throughput) ||
+	                (cpu_budget > 0 && cpu_share > cpu_budget);
+	bool plenty_of_room = (target_throughput <= 0 || throughput > target_throughput * ADAPTIVE_RAISE_MARGIN) &&
+	                      (cpu_budget <= 0 || cpu_share * ADAPTIVE_RAISE_MARGIN < cpu_budget);
+	if (too_slow && wanted_level > Z_BEST_SPEED) {
+		-- wanted_level;
+	} else if (plenty_of_room && wanted_level < Z_BEST_COMPRESSION) {
+		++ wanted_level;
 	}
 
+	window_bytes = 0;
+	window_nanoseconds = 0;
+	window_started = now;
 }
 
 }
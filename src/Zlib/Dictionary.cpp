@@ -0,0 +1,149 @@
+#include "Zlib/Dictionary.hpp"
+
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <zlib.h>
+
+namespace Agl
+{
+
+namespace Zlib
+{
+
+namespace
+{
+
+// Substrings shorter than this are not worth matching
+size_t const NGRAM_SIZE = 8;
+// Dictionary is built from pieces of this size, picked
+// from samples at positions that are multiples of the step.
+size_t const PIECE_SIZE = 32;
+size_t const PIECE_STEP = 8;
+
+struct Ngram
+{
+	// Amount of samples this appears in. Zero,
+	// if it is already covered by the dictionary.
+	uint32_t samples;
+	// Index of the last sample this was seen in, plus one
+	uint32_t last_sample;
+};
+
+typedef std::unordered_map< uint64_t, Ngram > Ngrams;
+
+struct Piece
+{
+	uint64_t score;
+	size_t sample;
+	size_t offset;
+	size_t size;
+
+	bool operator<(Piece const& piece) const
+	{
+		return score < piece.score;
+	}
+};
+
+uint64_t ngramAt(uint8_t const* pos)
+{
+	uint64_t result;
+	memcpy(&result, pos, NGRAM_SIZE);
+	return result;
+}
+
+// Sums how common the uncovered substrings of a piece are
+uint64_t scorePiece(Bytes const& sample, Piece const& piece, Ngrams const& ngrams)
+{
+	uint64_t score = 0;
+	for (size_t pos = piece.offset; pos + NGRAM_SIZE <= piece.offset + piece.size; ++ pos) {
+		Ngrams::const_iterator it = ngrams.find(ngramAt(sample.data() + pos));
+		// Substrings of only one sample do not help other samples
+		if (it != ngrams.end() && it->second.samples > 1) {
+			score += it->second.samples;
+		}
+	}
+	return score;
+}
+
+}
+
+Bytes buildDictionary(std::vector< Bytes > const& samples, size_t max_size)
+{
+	// Count in how many samples each substring appears
+	Ngrams ngrams;
+	for (size_t sample_i = 0; sample_i < samples.size(); ++ sample_i) {
+		Bytes const& sample = samples[sample_i];
+		for (size_t pos = 0; pos + NGRAM_SIZE <= sample.size(); ++ pos) {
+			Ngram& ngram = ngrams[ngramAt(sample.data() + pos)];
+			if (ngram.last_sample != sample_i + 1) {
+				ngram.last_sample = sample_i + 1;
+				++ ngram.samples;
+			}
+		}
+	}
+
+	std::priority_queue< Piece > pieces;
+	for (size_t sample_i = 0; sample_i < samples.size(); ++ sample_i) {
+		Bytes const& sample = samples[sample_i];
+		for (size_t offset = 0; offset + NGRAM_SIZE <= sample.size(); offset += PIECE_STEP) {
+			Piece piece;
+			piece.sample = sample_i;
+			piece.offset = offset;
+			piece.size = sample.size() - offset < PIECE_SIZE ? sample.size() - offset : PIECE_SIZE;
+			piece.score = scorePiece(sample, piece, ngrams);
+			if (piece.score > 0) {
+				pieces.push(piece);
+			}
+		}
+	}
+
+	// Pick the best pieces greedily. Picking a piece covers its
+	// substrings, which can only lower the scores of other pieces,
+	// so scores are updated only when a piece reaches the top.
+	std::vector< Piece > picked;
+	size_t picked_size = 0;
+	while (!pieces.empty() && picked_size < max_size) {
+		Piece piece = pieces.top();
+		pieces.pop();
+		Bytes const& sample = samples[piece.sample];
+		piece.score = scorePiece(sample, piece, ngrams);
+		if (piece.score == 0) {
+			continue;
+		}
+		if (!pieces.empty() && piece.score < pieces.top().score) {
+			pieces.push(piece);
+			continue;
+		}
+
+		picked.push_back(piece);
+		picked_size += piece.size;
+		for (size_t pos = piece.offset; pos + NGRAM_SIZE <= piece.offset + piece.size; ++ pos) {
+			Ngrams::iterator it = ngrams.find(ngramAt(sample.data() + pos));
+			if (it != ngrams.end()) {
+				it->second.samples = 0;
+			}
+		}
+	}
+
+	// Best pieces go to the end
+	Bytes result;
+	result.reserve(picked_size);
+	for (std::vector< Piece >::reverse_iterator it = picked.rbegin(); it != picked.rend(); ++ it) {
+		Bytes const& sample = samples[it->sample];
+		result.insert(result.end(), sample.begin() + it->offset, sample.begin() + it->offset + it->size);
+	}
+	if (result.size() > max_size) {
+		result.erase(result.begin(), result.end() - max_size);
+	}
+	return result;
+}
+
+uint32_t dictionaryId(Bytes const& dictionary)
+{
+	return adler32(adler32(0, Z_NULL, 0), dictionary.data(), dictionary.size());
+}
+
+}
+
+}
@@ -0,0 +1,187 @@
+#include "Zlib/Index.hpp"
+
+#include "Common.hpp"
+
+#include <stdexcept>
+#include <cstring>
+
+namespace Agl
+{
+
+namespace Zlib
+{
+
+namespace
+{
+
+// Serialized format begins with this, and a version number
+char const INDEX_MAGIC[8] = { 'A', 'G', 'L', 'Z', 'I', 'D', 'X', 0 };
+uint8_t const INDEX_VERSION = 1;
+
+void writeUint64(Bytes& result, uint64_t value)
+{
+	for (unsigned byte_i = 0; byte_i < 8; ++ byte_i) {
+		result.push_back(value >> (byte_i * 8));
+	}
+}
+
+uint64_t readUint64(Bytes const& bytes, size_t& pos)
+{
+	if (bytes.size() - pos < 8) {
+		throw std::runtime_error("Truncated index!");
+	}
+	uint64_t result = 0;
+	for (unsigned byte_i = 0; byte_i < 8; ++ byte_i) {
+		result |= uint64_t(bytes[pos + byte_i]) << (byte_i * 8);
+	}
+	pos += 8;
+	return result;
+}
+
+uint8_t readUint8(Bytes const& bytes, size_t& pos)
+{
+	if (pos >= bytes.size()) {
+		throw std::runtime_error("Truncated index!");
+	}
+	return bytes[pos ++];
+}
+
+}
+
+Index::Index(uint64_t spacing) :
+	point_spacing(spacing),
+	is_complete(false),
+	uncompressed_size(0)
+{
+}
+
+uint64_t Index::spacing() const
+{
+	return point_spacing;
+}
+
+size_t Index::size() const
+{
+	return points.size();
+}
+
+bool Index::empty() const
+{
+	return points.empty();
+}
+
+Index::AccessPoint const& Index::operator[](size_t point_i) const
+{
+	return points[point_i];
+}
+
+Index::AccessPoint const& Index::find(uint64_t uncompressed_offset) const
+{
+	if (points.empty()) {
+		throw std::runtime_error("Index has no access points!");
+	}
+	// Binary search for the last point that is not after the offset
+	size_t begin = 0;
+	size_t end = points.size();
+	while (end - begin > 1) {
+		size_t middle = begin + (end - begin) / 2;
+		if (points[middle].uncompressed_offset <= uncompressed_offset) {
+			begin = middle;
+		} else {
+			end = middle;
+		}
+	}
+	return points[begin];
+}
+
+bool Index::complete() const
+{
+	return is_complete;
+}
+
+uint64_t Index::uncompressedSize() const
+{
+	return uncompressed_size;
+}
+
+void Index::clear()
+{
+	points.clear();
+	is_complete = false;
+	uncompressed_size = 0;
+}
+
+void Index::addPoint(AccessPoint const& point)
+{
+	if (!points.empty() && point.uncompressed_offset < points.back().uncompressed_offset) {
+		throw std::runtime_error("Access points must be added in order!");
+	}
+	points.push_back(point);
+}
+
+void Index::setComplete(uint64_t uncompressed_size)
+{
+	is_complete = true;
+	this->uncompressed_size = uncompressed_size;
+}
+
+Bytes Index::serialize() const
+{
+	Bytes result(INDEX_MAGIC, INDEX_MAGIC + sizeof(INDEX_MAGIC));
+	result.push_back(INDEX_VERSION);
+	writeUint64(result, point_spacing);
+	result.push_back(is_complete ? 1 : 0);
+	writeUint64(result, uncompressed_size);
+	writeUint64(result, points.size());
+	for (AccessPoints::const_iterator it = points.begin(); it != points.end(); ++ it) {
+		writeUint64(result, it->uncompressed_offset);
+		writeUint64(result, it->compressed_offset);
+		result.push_back(it->bits);
+		writeUint64(result, it->window.size());
+		result.insert(result.end(), it->window.begin(), it->window.end());
+	}
+	return result;
+}
+
+void Index::deserialize(Bytes const& bytes)
+{
+	if (bytes.size() < sizeof(INDEX_MAGIC) || memcmp(bytes.data(), INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+		throw std::runtime_error("Data is not an index!");
+	}
+	size_t pos = sizeof(INDEX_MAGIC);
+	if (readUint8(bytes, pos) != INDEX_VERSION) {
+		throw std::runtime_error("Unsupported index version!");
+	}
+
+	uint64_t new_spacing = readUint64(bytes, pos);
+	bool new_complete = readUint8(bytes, pos) != 0;
+	uint64_t new_uncompressed_size = readUint64(bytes, pos);
+	uint64_t points_size = readUint64(bytes, pos);
+
+	AccessPoints new_points;
+	for (uint64_t point_i = 0; point_i < points_size; ++ point_i) {
+		AccessPoint point;
+		point.uncompressed_offset = readUint64(bytes, pos);
+		point.compressed_offset = readUint64(bytes, pos);
+		point.bits = readUint8(bytes, pos);
+		uint64_t window_size = readUint64(bytes, pos);
+		if (point.bits > 7 || window_size > WINDOW_SIZE || bytes.size() - pos < window_size) {
+			throw std::runtime_error("Invalid index!");
+		}
+		if (!new_points.empty() && point.uncompressed_offset < new_points.back().uncompressed_offset) {
+			throw std::runtime_error("Invalid index!");
+		}
+		point.window.assign(bytes.begin() + pos, bytes.begin() + pos + window_size);
+		pos += window_size;
+		new_points.push_back(point);
+	}
+
+	point_spacing = new_spacing;
+	points.swap(new_points);
+	is_complete = new_complete;
+	uncompressed_size = new_uncompressed_size;
+}
+
+}
+
+}
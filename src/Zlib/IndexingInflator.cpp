@@ -0,0 +1,186 @@
+#include "Zlib/IndexingInflator.hpp"
+
+#include "Common.hpp"
+
+#include <zlib.h>
+
+namespace Agl
+{
+
+namespace Zlib
+{
+
+IndexingInflator::IndexingInflator(Index& index) :
+	stream_end(false),
+	index(index),
+	last_point_offset(0),
+	window(WINDOW_SIZE, 0),
+	window_pos(0)
+{
+	index.clear();
+
+	zstrm = new z_stream;
+	// Tune allocation of zstream
+	z_streamp(zstrm)->zalloc = Z_NULL;
+	z_streamp(zstrm)->zfree = Z_NULL;
+	// Disable buffers at first
+	z_streamp(zstrm)->next_in = Z_NULL;
+	z_streamp(zstrm)->avail_in = 0;
+	z_streamp(zstrm)->next_out = Z_NULL;
+	z_streamp(zstrm)->avail_out = 0;
+
+	// Accept both zlib and gzip headers
+	int err = inflateInit2(z_streamp(zstrm), 15 + 32);
+	if (err == Z_MEM_ERROR) {
+		delete z_streamp(zstrm);
+		throw std::bad_alloc();
+	}
+	if (err == Z_VERSION_ERROR) {
+		delete z_streamp(zstrm);
+		throw std::runtime_error("Invalid zlib version!");
+	}
+}
+
+IndexingInflator::~IndexingInflator()
+{
+	inflateEnd(z_streamp(zstrm));
+	delete z_streamp(zstrm);
+}
+
+void IndexingInflator::newDataAvailable(uint64_t amount, bool end_of_data)
+{
+	(void)amount;
+
+	uint8_t const* input_begin;
+	size_t input_size;
+	while (!stream_end && !outputFull()) {
+		input_size = viewInputData(input_begin);
+		z_streamp(zstrm)->next_in = input_size > 0 ? (Bytef*)input_begin : Z_NULL;
+		z_streamp(zstrm)->avail_in = input_size;
+		runInflate();
+		consumeInputData(input_size - z_streamp(zstrm)->avail_in);
+		if (input_size == 0) {
+			break;
+		}
+	}
+	z_streamp(zstrm)->next_in = Z_NULL;
+	z_streamp(zstrm)->avail_in = 0;
+
+	// Data after the end of compressed stream is ignored
+	if (stream_end) {
+		consumeInputData(inputDataSize());
+	}
+
+	if (end_of_data && !stream_end && inputDataSize() == 0 && !outputFull()) {
+		throw std::runtime_error("Unexpected end of compressed data!");
+	}
+}
+
+void IndexingInflator::resetRequested()
+{
+	if (inflateReset(z_streamp(zstrm)) != Z_OK) {
+		throw std::runtime_error("Unable to reset zlib inflate()!");
+	}
+	stream_end = false;
+	index.clear();
+	last_point_offset = 0;
+	window_pos = 0;
+}
+
+void IndexingInflator::runInflate()
+{
+	size_t const OUTPUT_CHUNK_SIZE = 16 * 1024;
+
+	while (true) {
+		uint8_t* output_begin;
+		size_t output_size = reserveOutputData(output_begin, OUTPUT_CHUNK_SIZE);
+		z_streamp(zstrm)->next_out = output_begin;
+		z_streamp(zstrm)->avail_out = output_size;
+
+		int err = inflate(z_streamp(zstrm), Z_BLOCK);
+		if (err == Z_DATA_ERROR) {
+			throw std::runtime_error("Corrupted data!");
+		}
+		if (err == Z_STREAM_ERROR) {
+			throw std::runtime_error("Stream error in zlib inflate()!");
+		}
+		if (err == Z_NEED_DICT) {
+			throw std::runtime_error("Compressed data requires a dictionary!");
+		}
+		if (err == Z_MEM_ERROR) {
+			throw std::bad_alloc();
+		}
+
+		size_t written = output_size - z_streamp(zstrm)->avail_out;
+		updateWindow(output_begin, written);
+		commitOutputData(written);
+
+		if (err == Z_STREAM_END) {
+			stream_end = true;
+			index.setComplete(z_streamp(zstrm)->total_out);
+			break;
+		}
+		addPointIfNeeded();
+
+		// Z_BUF_ERROR means more input is needed
+		if (err == Z_BUF_ERROR) {
+			break;
+		}
+		if (outputFull()) {
+			break;
+		}
+		if (z_streamp(zstrm)->avail_in == 0 && z_streamp(zstrm)->avail_out != 0) {
+			break;
+		}
+	}
+}
+
+void IndexingInflator::updateWindow(uint8_t const* begin, size_t size)
+{
+	if (size >= WINDOW_SIZE) {
+		memcpy(window.data(), begin + size - WINDOW_SIZE, WINDOW_SIZE);
+		window_pos = 0;
+		return;
+	}
+	size_t first_size = WINDOW_SIZE - window_pos;
+	if (first_size > size) first_size = size;
+	memcpy(window.data() + window_pos, begin, first_size);
+	memcpy(window.data(), begin + first_size, size - first_size);
+	window_pos = (window_pos + size) % WINDOW_SIZE;
+}
+
+void IndexingInflator::addPointIfNeeded()
+{
+	// Points can be only at the end of a deflate block
+	// header, and not after the last block.
+	int data_type = z_streamp(zstrm)->data_type;
+	if (!(data_type & 128) || (data_type & 64)) {
+		return;
+	}
+	uint64_t total_out = z_streamp(zstrm)->total_out;
+	if (!index.empty() && total_out - last_point_offset < index.spacing()) {
+		return;
+	}
+
+	Index::AccessPoint point;
+	point.uncompressed_offset = total_out;
+	point.compressed_offset = z_streamp(zstrm)->total_in;
+	point.bits = data_type & 7;
+
+	// Store window in the order of data
+	size_t window_size = total_out < WINDOW_SIZE ? total_out : WINDOW_SIZE;
+	point.window.reserve(window_size);
+	if (window_size > window_pos) {
+		point.window.insert(point.window.end(), window.end() - (window_size - window_pos), window.end());
+		point.window.insert(point.window.end(), window.begin(), window.begin() + window_pos);
+	} else {
+		point.window.insert(point.window.end(), window.begin() + window_pos - window_size, window.begin() + window_pos);
+	}
+
+	index.addPoint(point);
+	last_point_offset = total_out;
+}
+
+}
+
+}
@@ -1,5 +1,7 @@
 #include "Zlib/Inflator.hpp"
 
+#include "Common.hpp"
+
 #include <zlib.h>
 
 namespace Agl
@@ -8,23 +10,29 @@ namespace Agl
 namespace Zlib
 {
 
-Inflator::Inflator()
+Inflator::Inflator(Allocator* allocator) :
+	max_output_size(0),
+	expected_size(0),
+	total_output(0),
+	stream_end(false)
 {
 	zstrm = new z_stream;
 	// Tune allocation of zstream
-	z_streamp(zstrm)->zalloc = Z_NULL;
-	z_streamp(zstrm)->zfree = Z_NULL;
+	setAllocator(z_streamp(zstrm), allocator);
 	// Disable buffers at first
 	z_streamp(zstrm)->next_in = Z_NULL;
 	z_streamp(zstrm)->avail_in = 0;
 	z_streamp(zstrm)->next_out = Z_NULL;
 	z_streamp(zstrm)->avail_out = 0;
 
-	int err = inflateInit(z_streamp(zstrm));
+	// Accept both zlib and gzip headers
+	int err = inflateInit2(z_streamp(zstrm), 15 + 32);
 	if (err == Z_MEM_ERROR) {
+		delete z_streamp(zstrm);
 		throw std::bad_alloc();
 	}
 	if (err == Z_VERSION_ERROR) {
+		delete z_streamp(zstrm);
 		throw std::runtime_error("Invalid zlib version!");
 	}
 }
@@ -35,46 +43,141 @@ Inflator::~Inflator()
 	delete z_streamp(zstrm);
 }
 
+double Inflator::compressionRatio() const
+{
+	uLong compressed = z_streamp(zstrm)->total_in;
+	if (compressed == 0) return 0;
+	return double(z_streamp(zstrm)->total_out) / double(compressed);
+}
+
+void Inflator::setDictionary(Bytes const& dictionary)
+{
+	this->dictionary = dictionary;
+}
+
+void Inflator::setMaxOutputSize(size_t max_size)
+{
+	max_output_size = max_size;
+}
+
+void Inflator::setExpectedSize(size_t size)
+{
+	expected_size = size;
+}
+
 void Inflator::newDataAvailable(uint64_t amount, bool end_of_data)
 {
 	(void)amount;
 
-	Bytes bytes;
-	readInputData(bytes);
+	// Decompress input data in place, until output gets full. This is
+	// done also when there is no input, because zlib might still have
+	// some pending output from the time output got full.
+	uint8_t const* input_begin;
+	size_t input_size;
+	while (!stream_end && !outputFull()) {
+		input_size = viewInputData(input_begin);
+		z_streamp(zstrm)->next_in = input_size > 0 ? (Bytef*)input_begin : Z_NULL;
+		z_streamp(zstrm)->avail_in = input_size;
+		runInflate(Z_NO_FLUSH);
+		consumeInputData(input_size - z_streamp(zstrm)->avail_in);
+		if (input_size == 0) {
+			break;
+		}
+	}
+	z_streamp(zstrm)->next_in = Z_NULL;
+	z_streamp(zstrm)->avail_in = 0;
+
+	// Data after the end of compressed stream is ignored
+	if (stream_end) {
+		consumeInputData(inputDataSize());
+	}
+
+	if (end_of_data && !stream_end && inputDataSize() == 0 && !outputFull()) {
+		throw std::runtime_error("Unexpected end of compressed data!");
+	}
+}
 
-	size_t OUTPUT_BUF_SIZE = 16 * 1024;
-	uint8_t output_buf[OUTPUT_BUF_SIZE];
+void Inflator::resetRequested()
+{
+	if (inflateReset(z_streamp(zstrm)) != Z_OK) {
+		throw std::runtime_error("Unable to reset zlib inflate()!");
+	}
+	total_output = 0;
+	stream_end = false;
+}
 
-	z_streamp(zstrm)->next_in = &bytes[0];
-	z_streamp(zstrm)->avail_in = bytes.size();
-	z_streamp(zstrm)->next_out = output_buf;
-	z_streamp(zstrm)->avail_out = OUTPUT_BUF_SIZE;
+void Inflator::runInflate(int flush)
+{
+	size_t const OUTPUT_CHUNK_SIZE = 16 * 1024;
 
 	while (true) {
-		int err = inflate(z_streamp(zstrm), end_of_data ? Z_FINISH : Z_NO_FLUSH);
+		// Reserve room for all of the expected output at once
+		size_t chunk_size = OUTPUT_CHUNK_SIZE;
+		if (expected_size > total_output + chunk_size) {
+			chunk_size = expected_size - total_output;
+		}
+		// One byte over the limit is enough to see that it is exceeded
+		size_t room = max_output_size - total_output + 1;
+		if (max_output_size > 0 && chunk_size > room) {
+			chunk_size = room;
+		}
+
+		// Decompress directly to output buffer
+		uint8_t* output_begin;
+		size_t output_size = reserveOutputData(output_begin, chunk_size);
+		if (max_output_size > 0 && output_size > room) {
+			output_size = room;
+		}
+		z_streamp(zstrm)->next_out = output_begin;
+		z_streamp(zstrm)->avail_out = output_size;
+
+		int err = inflate(z_streamp(zstrm), flush);
+		size_t written = output_size - z_streamp(zstrm)->avail_out;
+		total_output += written;
+		if (max_output_size > 0 && total_output > max_output_size) {
+			throw OutputLimitExceeded();
+		}
+
 		if (err == Z_DATA_ERROR) {
 			throw std::runtime_error("Corrupted data!");
 		}
 		if (err == Z_STREAM_ERROR) {
 			throw std::runtime_error("Stream error in zlib inflate()!");
 		}
-		if (err == Z_BUF_ERROR) {
-			throw std::runtime_error("Buffer error in zlib inflate()!");
+		if (err == Z_NEED_DICT) {
+			if (dictionary.empty()) {
+				throw std::runtime_error("Compressed data requires a dictionary!");
+			}
+			// This also checks that the dictionary has the required id
+			if (inflateSetDictionary(z_streamp(zstrm), dictionary.data(), dictionary.size()) != Z_OK) {
+				throw std::runtime_error("Compressed data requires a different dictionary!");
+			}
+			commitOutputData(written);
+			continue;
+		}
+		if (err == Z_MEM_ERROR) {
+			throw std::bad_alloc();
 		}
 
-		// Read everything from output buffer
-		writeOutputData(output_buf, z_streamp(zstrm)->next_out);
+		commitOutputData(written);
 
-		if ((!end_of_data && z_streamp(zstrm)->avail_in == 0) ||
-		    (end_of_data && err == Z_STREAM_END)) {
+		if (err == Z_STREAM_END) {
+			stream_end = true;
+			break;
+		}
+		// Z_BUF_ERROR means more input is needed
+		if (err == Z_BUF_ERROR) {
+			break;
+		}
+		// Rest is done when output has been read
+		if (outputFull()) {
+			break;
+		}
+		// Continue until zlib has no more pending output
+		if (z_streamp(zstrm)->avail_in == 0 && z_streamp(zstrm)->avail_out != 0) {
 			break;
 		}
-
-		// Reset output buffer
-		z_streamp(zstrm)->next_out = output_buf;
-		z_streamp(zstrm)->avail_out = OUTPUT_BUF_SIZE;
 	}
-
 }
 
 }
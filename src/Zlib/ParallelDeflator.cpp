@@ -0,0 +1,370 @@
+#include "Zlib/ParallelDeflator.hpp"
+
+#include "Common.hpp"
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+namespace Agl
+{
+
+namespace Zlib
+{
+
+struct ParallelDeflator::Job
+{
+	Bytes input;
+	size_t input_size;
+	Bytes dictionary;
+	bool last;
+
+	// These are set by worker
+	Bytes output;
+	uint32_t check;
+	bool done;
+	std::exception_ptr error;
+};
+
+struct ParallelDeflator::Workers
+{
+	std::mutex mutex;
+	std::condition_variable work_cond;
+	std::condition_variable done_cond;
+
+	// Jobs that no worker has started yet
+	Jobs queue;
+	bool stopping;
+
+	std::vector< std::thread > threads;
+};
+
+ParallelDeflator::ParallelDeflator(Deflator::Level level, Format format, size_t threads, size_t block_size) :
+	zlevel(toZlibLevel(level)),
+	format(format),
+	block_size(block_size),
+	header_written(false),
+	last_block_given(false),
+	trailer_written(false),
+	flush_pending(false),
+	check(format == ZLIB ? adler32(0, Z_NULL, 0) : crc32(0, Z_NULL, 0)),
+	total_size(0)
+{
+	if (block_size == 0) {
+		throw std::runtime_error("Block size must be positive!");
+	}
+	if (threads == 0) {
+		threads = std::thread::hardware_concurrency();
+		if (threads == 0) threads = 1;
+	}
+	// Keep all workers busy, while finished blocks wait for writing
+	max_jobs = threads * 2;
+
+	workers = new Workers;
+	workers->stopping = false;
+	try {
+		for (size_t thread_i = 0; thread_i < threads; ++ thread_i) {
+			workers->threads.push_back(std::thread(&ParallelDeflator::runWorker, workers, zlevel, format));
+		}
+	}
+	catch (...) {
+		{
+			std::lock_guard< std::mutex > lock(workers->mutex);
+			workers->stopping = true;
+		}
+		workers->work_cond.notify_all();
+		for (size_t thread_i = 0; thread_i < workers->threads.size(); ++ thread_i) {
+			workers->threads[thread_i].join();
+		}
+		delete workers;
+		throw;
+	}
+}
+
+ParallelDeflator::~ParallelDeflator()
+{
+	{
+		std::lock_guard< std::mutex > lock(workers->mutex);
+		workers->stopping = true;
+	}
+	workers->work_cond.notify_all();
+	for (size_t thread_i = 0; thread_i < workers->threads.size(); ++ thread_i) {
+		workers->threads[thread_i].join();
+	}
+	delete workers;
+}
+
+void ParallelDeflator::newDataAvailable(uint64_t amount, bool end_of_data)
+{
+	(void)amount;
+
+	if (trailer_written) {
+		return;
+	}
+	if (!header_written) {
+		writeHeader();
+	}
+
+	collectBlocks(false);
+
+	// Give full blocks to workers. The last block may be shorter.
+	while (!outputFull() && !last_block_given) {
+		size_t input_size = inputDataSize();
+		bool last = end_of_data && input_size <= block_size;
+		if (input_size < block_size && !last) {
+			break;
+		}
+		if (jobs.size() >= max_jobs) {
+			collectBlocks(true);
+			continue;
+		}
+		giveBlock(last);
+	}
+
+	if (flush_pending && !last_block_given) {
+		// Blocks end at byte boundary, so after all blocks
+		// are written, everything can be decompressed.
+		while (!outputFull() && inputDataSize() > 0) {
+			if (jobs.size() >= max_jobs) {
+				collectBlocks(true);
+			} else {
+				giveBlock(false);
+			}
+		}
+		while (!jobs.empty() && !outputFull()) {
+			collectBlocks(true);
+		}
+		if (jobs.empty() && inputDataSize() == 0) {
+			flush_pending = false;
+		}
+	}
+
+	if (last_block_given) {
+		while (!jobs.empty() && !outputFull()) {
+			collectBlocks(true);
+		}
+		if (jobs.empty()) {
+			writeTrailer();
+		}
+	}
+}
+
+void ParallelDeflator::resetRequested()
+{
+	// Workers keep their own references to the jobs they are running, so
+	// unfinished jobs can be dropped without waiting. Results are ignored.
+	{
+		std::lock_guard< std::mutex > lock(workers->mutex);
+		workers->queue.clear();
+	}
+	jobs.clear();
+
+	header_written = false;
+	last_block_given = false;
+	trailer_written = false;
+	flush_pending = false;
+	check = format == ZLIB ? adler32(0, Z_NULL, 0) : crc32(0, Z_NULL, 0);
+	total_size = 0;
+	dictionary.clear();
+}
+
+void ParallelDeflator::flushRequested()
+{
+	flush_pending = true;
+}
+
+void ParallelDeflator::giveBlock(bool last)
+{
+	std::shared_ptr< Job > job(new Job);
+	readInputData(job->input, block_size);
+	job->input_size = job->input.size();
+	job->dictionary = dictionary;
+	job->last = last;
+	job->check = 0;
+	job->done = false;
+
+	if (!last) {
+		// Remember end of data for the next block
+		Bytes& input = job->input;
+		if (input.size() >= WINDOW_SIZE) {
+			dictionary.assign(input.end() - WINDOW_SIZE, input.end());
+		} else {
+			dictionary.insert(dictionary.end(), input.begin(), input.end());
+			if (dictionary.size() > WINDOW_SIZE) {
+				dictionary.erase(dictionary.begin(), dictionary.end() - WINDOW_SIZE);
+			}
+		}
+	}
+
+	jobs.push_back(job);
+	{
+		std::lock_guard< std::mutex > lock(workers->mutex);
+		workers->queue.push_back(job);
+	}
+	workers->work_cond.notify_one();
+
+	if (last) {
+		last_block_given = true;
+	}
+}
+
+void ParallelDeflator::collectBlocks(bool wait)
+{
+	while (!jobs.empty() && !outputFull()) {
+		std::shared_ptr< Job > job = jobs.front();
+		{
+			std::unique_lock< std::mutex > lock(workers->mutex);
+			while (wait && !job->done) {
+				workers->done_cond.wait(lock);
+			}
+			if (!job->done) {
+				return;
+			}
+		}
+		wait = false;
+		jobs.pop_front();
+
+		if (job->error) {
+			std::rethrow_exception(job->error);
+		}
+
+		writeOutputData(job->output.data(), job->output.data() + job->output.size());
+
+		if (format == ZLIB) {
+			check = adler32_combine(check, job->check, job->input_size);
+		} else {
+			check = crc32_combine(check, job->check, job->input_size);
+		}
+		total_size += job->input_size;
+	}
+}
+
+void ParallelDeflator::writeHeader()
+{
+	if (format == ZLIB) {
+		// Deflate with 32 KiB window, and a hint about compression level
+		uint8_t header[2];
+		header[0] = 0x78;
+		uint8_t level_hint;
+		if (zlevel == Z_DEFAULT_COMPRESSION || zlevel == 6) level_hint = 2;
+		else if (zlevel < 2) level_hint = 0;
+		else if (zlevel < 6) level_hint = 1;
+		else level_hint = 3;
+		header[1] = level_hint << 6;
+		header[1] += 31 - (header[0] * 256 + header[1]) % 31;
+		writeOutputData(header, header + 2);
+	} else {
+		// No file name or modification time. Operating system is Unix.
+		uint8_t header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };
+		if (zlevel == Z_BEST_COMPRESSION) header[8] = 2;
+		else if (zlevel == Z_BEST_SPEED) header[8] = 4;
+		writeOutputData(header, header + 10);
+	}
+	header_written = true;
+}
+
+void ParallelDeflator::writeTrailer()
+{
+	if (format == ZLIB) {
+		uint8_t trailer[4];
+		trailer[0] = check >> 24;
+		trailer[1] = check >> 16;
+		trailer[2] = check >> 8;
+		trailer[3] = check;
+		writeOutputData(trailer, trailer + 4);
+	} else {
+		uint8_t trailer[8];
+		for (unsigned i = 0; i < 4; ++ i) {
+			trailer[i] = check >> (i * 8);
+			trailer[4 + i] = total_size >> (i * 8);
+		}
+		writeOutputData(trailer, trailer + 8);
+	}
+	trailer_written = true;
+}
+
+void ParallelDeflator::runWorker(Workers* workers, int zlevel, Format format)
+{
+	// Raw deflate, because headers and checksums are written separately
+	z_stream zstrm;
+	zstrm.zalloc = Z_NULL;
+	zstrm.zfree = Z_NULL;
+	zstrm.opaque = Z_NULL;
+	int init_err = deflateInit2(&zstrm, zlevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+
+	std::unique_lock< std::mutex > lock(workers->mutex);
+	while (true) {
+		while (!workers->stopping && workers->queue.empty()) {
+			workers->work_cond.wait(lock);
+		}
+		if (workers->stopping) {
+			break;
+		}
+		std::shared_ptr< Job > job = workers->queue.front();
+		workers->queue.pop_front();
+		lock.unlock();
+
+		try {
+			if (init_err == Z_MEM_ERROR) {
+				throw std::bad_alloc();
+			}
+			if (init_err != Z_OK) {
+				throw std::runtime_error("Unable to initialize zlib deflate()!");
+			}
+
+			if (format == ZLIB) {
+				job->check = adler32(adler32(0, Z_NULL, 0), job->input.data(), job->input.size());
+			} else {
+				job->check = crc32(crc32(0, Z_NULL, 0), job->input.data(), job->input.size());
+			}
+
+			deflateReset(&zstrm);
+			if (!job->dictionary.empty()) {
+				deflateSetDictionary(&zstrm, job->dictionary.data(), job->dictionary.size());
+			}
+
+			// Blocks other than the last end at byte boundary
+			// without being final, so they can be concatenated.
+			int flush = job->last ? Z_FINISH : Z_SYNC_FLUSH;
+			zstrm.next_in = job->input.data();
+			zstrm.avail_in = job->input.size();
+			job->output.resize(deflateBound(&zstrm, job->input.size()) + 16);
+			size_t output_size = 0;
+			while (true) {
+				zstrm.next_out = job->output.data() + output_size;
+				zstrm.avail_out = job->output.size() - output_size;
+				int err = deflate(&zstrm, flush);
+				output_size = job->output.size() - zstrm.avail_out;
+				if (err == Z_STREAM_ERROR) {
+					throw std::runtime_error("Stream error in zlib deflate()!");
+				}
+				if (err == Z_STREAM_END || (flush == Z_SYNC_FLUSH && zstrm.avail_in == 0 && zstrm.avail_out != 0)) {
+					break;
+				}
+				job->output.resize(job->output.size() * 2);
+			}
+			job->output.resize(output_size);
+		}
+		catch (...) {
+			job->error = std::current_exception();
+		}
+		job->input = Bytes();
+		job->dictionary = Bytes();
+
+		lock.lock();
+		job->done = true;
+		workers->done_cond.notify_all();
+	}
+	lock.unlock();
+
+	if (init_err == Z_OK) {
+		deflateEnd(&zstrm);
+	}
+}
+
+}
+
+}
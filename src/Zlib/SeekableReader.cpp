@@ -0,0 +1,166 @@
+#include "Zlib/SeekableReader.hpp"
+
+#include <stdexcept>
+#include <cerrno>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace Agl
+{
+
+namespace Zlib
+{
+
+namespace
+{
+
+size_t const INPUT_CHUNK_SIZE = 16 * 1024;
+size_t const DISCARD_CHUNK_SIZE = 16 * 1024;
+
+}
+
+SeekableReader::SeekableReader(int fd, Index const& index) :
+	fd(fd),
+	index(index),
+	active(false),
+	stream_end(false),
+	position(0),
+	compressed_position(0),
+	input(INPUT_CHUNK_SIZE, 0)
+{
+	zstrm = new z_stream;
+	z_streamp(zstrm)->zalloc = Z_NULL;
+	z_streamp(zstrm)->zfree = Z_NULL;
+	z_streamp(zstrm)->opaque = Z_NULL;
+	z_streamp(zstrm)->next_in = Z_NULL;
+	z_streamp(zstrm)->avail_in = 0;
+
+	// Raw deflate, because access points are inside deflate data
+	int err = inflateInit2(z_streamp(zstrm), -15);
+	if (err == Z_MEM_ERROR) {
+		delete z_streamp(zstrm);
+		throw std::bad_alloc();
+	}
+	if (err == Z_VERSION_ERROR) {
+		delete z_streamp(zstrm);
+		throw std::runtime_error("Invalid zlib version!");
+	}
+}
+
+SeekableReader::~SeekableReader()
+{
+	inflateEnd(z_streamp(zstrm));
+	delete z_streamp(zstrm);
+}
+
+size_t SeekableReader::read(uint64_t offset, uint8_t* result, size_t amount)
+{
+	if (amount == 0) {
+		return 0;
+	}
+
+	// Continue from the current position, unless
+	// there is an access point closer to the offset.
+	if (!active || offset < position || index.find(offset).uncompressed_offset > position) {
+		startFrom(offset);
+	}
+
+	// Skip data before the offset
+	if (offset > position) {
+		uint8_t discard[DISCARD_CHUNK_SIZE];
+		while (offset > position) {
+			size_t discard_size = offset - position < DISCARD_CHUNK_SIZE ? offset - position : DISCARD_CHUNK_SIZE;
+			if (inflateTo(discard, discard_size) < discard_size) {
+				return 0;
+			}
+		}
+	}
+
+	return inflateTo(result, amount);
+}
+
+void SeekableReader::startFrom(uint64_t offset)
+{
+	Index::AccessPoint const& point = index.find(offset);
+
+	int err = inflateReset(z_streamp(zstrm));
+	if (err != Z_OK) {
+		throw std::runtime_error("Unable to reset zlib inflate()!");
+	}
+	z_streamp(zstrm)->next_in = Z_NULL;
+	z_streamp(zstrm)->avail_in = 0;
+	active = false;
+	stream_end = false;
+
+	// Some bits of the previous byte might belong to this point
+	if (point.bits > 0) {
+		uint8_t byte;
+		size_t byte_size;
+		if (!readInput(point.compressed_offset - 1, &byte, 1, byte_size)) {
+			throw std::runtime_error("Compressed file is shorter than its index!");
+		}
+		inflatePrime(z_streamp(zstrm), point.bits, byte >> (8 - point.bits));
+	}
+	if (!point.window.empty()) {
+		err = inflateSetDictionary(z_streamp(zstrm), point.window.data(), point.window.size());
+		if (err != Z_OK) {
+			throw std::runtime_error("Unable to set window of access point!");
+		}
+	}
+
+	position = point.uncompressed_offset;
+	compressed_position = point.compressed_offset;
+	active = true;
+}
+
+size_t SeekableReader::inflateTo(uint8_t* result, size_t amount)
+{
+	size_t total = 0;
+	while (total < amount && !stream_end) {
+		if (z_streamp(zstrm)->avail_in == 0) {
+			size_t input_size;
+			if (!readInput(compressed_position, input.data(), input.size(), input_size)) {
+				active = false;
+				throw std::runtime_error("Unexpected end of compressed data!");
+			}
+			compressed_position += input_size;
+			z_streamp(zstrm)->next_in = input.data();
+			z_streamp(zstrm)->avail_in = input_size;
+		}
+
+		z_streamp(zstrm)->next_out = result + total;
+		z_streamp(zstrm)->avail_out = amount - total;
+		int err = inflate(z_streamp(zstrm), Z_NO_FLUSH);
+		size_t written = amount - total - z_streamp(zstrm)->avail_out;
+		total += written;
+		position += written;
+
+		if (err == Z_STREAM_END) {
+			stream_end = true;
+		} else if (err == Z_MEM_ERROR) {
+			active = false;
+			throw std::bad_alloc();
+		} else if (err != Z_OK && err != Z_BUF_ERROR) {
+			active = false;
+			throw std::runtime_error("Corrupted data!");
+		}
+	}
+	return total;
+}
+
+bool SeekableReader::readInput(uint64_t offset, uint8_t* result, size_t amount, size_t& result_size)
+{
+	ssize_t got;
+	do {
+		got = pread(fd, result, amount, offset);
+	} while (got < 0 && errno == EINTR);
+	if (got < 0) {
+		throw std::runtime_error("Unable to read compressed file!");
+	}
+	result_size = got;
+	return got > 0;
+}
+
+}
+
+}
@@ -0,0 +1,108 @@
+#include "Zstd/Compressor.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <zstd.h>
+
+namespace Agl
+{
+
+namespace Zstd
+{
+
+namespace
+{
+
+int toZstdLevel(Compressor::Level level)
+{
+	switch (level) {
+	case Compressor::FAST:
+		return 1;
+	case Compressor::BEST:
+		// Levels above this need a lot of memory also when decompressing
+		return 19;
+	default:
+		return ZSTD_CLEVEL_DEFAULT;
+	}
+}
+
+size_t check(size_t code)
+{
+	if (ZSTD_isError(code)) {
+		throw std::runtime_error(std::string("Zstandard error: ") + ZSTD_getErrorName(code) + "!");
+	}
+	return code;
+}
+
+}
+
+Compressor::Compressor(Level level) :
+	frame_ended(false),
+	pending_flush(false)
+{
+	ZSTD_CCtx* zstd_cctx = ZSTD_createCCtx();
+	if (!zstd_cctx) {
+		throw std::bad_alloc();
+	}
+	cctx = zstd_cctx;
+	check(ZSTD_CCtx_setParameter(zstd_cctx, ZSTD_c_compressionLevel, toZstdLevel(level)));
+	check(ZSTD_CCtx_setParameter(zstd_cctx, ZSTD_c_checksumFlag, 1));
+}
+
+Compressor::~Compressor()
+{
+	ZSTD_freeCCtx((ZSTD_CCtx*)cctx);
+}
+
+void Compressor::newDataAvailable(uint64_t amount, bool end_of_data)
+{
+	(void)amount;
+
+	// Compress directly to output buffer, until output gets full. Flushing
+	// and ending are done with the last piece of input, and they are
+	// continued until Zstandard says that nothing is left.
+	while (!frame_ended && !outputFull()) {
+		uint8_t const* input_begin;
+		size_t input_size = viewInputData(input_begin);
+		bool last_input = input_size == inputDataSize();
+		ZSTD_EndDirective directive = ZSTD_e_continue;
+		if (last_input && end_of_data) {
+			directive = ZSTD_e_end;
+		} else if (last_input && pending_flush) {
+			directive = ZSTD_e_flush;
+		}
+
+		uint8_t* output_begin;
+		size_t output_size = reserveOutputData(output_begin, ZSTD_CStreamOutSize());
+		ZSTD_inBuffer input = { input_size > 0 ? input_begin : NULL, input_size, 0 };
+		ZSTD_outBuffer output = { output_begin, output_size, 0 };
+		size_t left = check(ZSTD_compressStream2((ZSTD_CCtx*)cctx, &output, &input, directive));
+		consumeInputData(input.pos);
+		commitOutputData(output.pos);
+
+		if (directive != ZSTD_e_continue && left == 0) {
+			frame_ended = directive == ZSTD_e_end;
+			pending_flush = false;
+			break;
+		}
+		if (directive == ZSTD_e_continue && input.pos == 0 && output.pos == 0) {
+			break;
+		}
+	}
+}
+
+void Compressor::resetRequested()
+{
+	check(ZSTD_CCtx_reset((ZSTD_CCtx*)cctx, ZSTD_reset_session_only));
+	frame_ended = false;
+	pending_flush = false;
+}
+
+void Compressor::flushRequested()
+{
+	pending_flush = true;
+}
+
+}
+
+}
@@ -0,0 +1,76 @@
+#include "Zstd/Decompressor.hpp"
+
+#include <stdexcept>
+#include <zstd.h>
+
+namespace Agl
+{
+
+namespace Zstd
+{
+
+Decompressor::Decompressor() :
+	frame_end(false)
+{
+	ZSTD_DCtx* zstd_dctx = ZSTD_createDCtx();
+	if (!zstd_dctx) {
+		throw std::bad_alloc();
+	}
+	dctx = zstd_dctx;
+}
+
+Decompressor::~Decompressor()
+{
+	ZSTD_freeDCtx((ZSTD_DCtx*)dctx);
+}
+
+void Decompressor::newDataAvailable(uint64_t amount, bool end_of_data)
+{
+	(void)amount;
+
+	// Decompress directly to output buffer, until output gets full. This
+	// is done also when there is no input, because Zstandard might still
+	// have some pending output from the time output got full.
+	while (!frame_end && !outputFull()) {
+		uint8_t const* input_begin;
+		size_t input_size = viewInputData(input_begin);
+		uint8_t* output_begin;
+		size_t output_size = reserveOutputData(output_begin, ZSTD_DStreamOutSize());
+		ZSTD_inBuffer input = { input_size > 0 ? input_begin : NULL, input_size, 0 };
+		ZSTD_outBuffer output = { output_begin, output_size, 0 };
+
+		size_t hint = ZSTD_decompressStream((ZSTD_DCtx*)dctx, &output, &input);
+		if (ZSTD_isError(hint)) {
+			throw std::runtime_error("Corrupted data!");
+		}
+		consumeInputData(input.pos);
+		commitOutputData(output.pos);
+
+		// Zero hint means that the frame is complete and flushed
+		if (hint == 0) {
+			frame_end = true;
+		}
+		if (input.pos == 0 && output.pos == 0) {
+			break;
+		}
+	}
+
+	// Data after the end of frame is ignored
+	if (frame_end) {
+		consumeInputData(inputDataSize());
+	}
+
+	if (end_of_data && !frame_end && inputDataSize() == 0 && !outputFull()) {
+		throw std::runtime_error("Unexpected end of compressed data!");
+	}
+}
+
+void Decompressor::resetRequested()
+{
+	ZSTD_DCtx_reset((ZSTD_DCtx*)dctx, ZSTD_reset_session_only);
+	frame_end = false;
+}
+
+}
+
+}